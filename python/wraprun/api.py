@@ -19,6 +19,7 @@ from .parsers import (TaskParser,
                       ArgumentParserError,
                       parse_globals)
 from .task import TaskGroup
+from . import rankfile
 
 
 class WraprunError(Exception):
@@ -175,7 +176,7 @@ class Wraprun(object):
             raise WraprunError(
                 'Too many task groups (> 2048) in bundle: '
                 'Aborting to protect ALPS stability.')
-        self._update_file(task_group)
+        self._env = None
 
     def _debug_mode(self):
         """Return True if debugging option is set."""
@@ -195,18 +196,48 @@ class Wraprun(object):
             else:
                 dir_path = os.getcwd()
             self._tmpfile = tempfile.NamedTemporaryFile(
-                'a+', prefix='wraprun_', suffix='.tmp', dir=dir_path,
+                'w+b', prefix='wraprun_', suffix='.tmp', dir=dir_path,
                 delete=True)
             # delete=not self._debug_mode())
         return self._tmpfile
 
-    def _update_file(self, task_group):
-        """Write rank runtime parameters of task_group to file."""
+    def _rank_ranges(self):
+        """Generator for the rank ranges of all task groups, in rank order."""
+        for task_group in self._task_groups:
+            for rank_range in task_group.rank_ranges:
+                yield rank_range
+
+    def _write_file(self, layout):
+        """Write the indexed rank runtime parameters file.
+
+        The range table sits ahead of the records, so the whole file is
+        regenerated rather than appended to. Its size grows with the number of
+        task splits, not ranks.
+        """
         tmpfile = self._file.file
-        for rank in task_group.ranks:
-            tmpfile.write(rank.string() + "\n")
+        tmpfile.seek(0)
+        tmpfile.truncate()
+        tmpfile.write(layout)
         tmpfile.flush()
 
+    def _layout_env(self):
+        """Return a dictionary holding the environment variable that locates
+        the rank runtime parameters.
+
+        Small layouts are passed directly in the environment so libsplit never
+        touches the file system to find its parameters. Layouts whose encoding
+        exceeds the launcher environment size limit are written to a file.
+        """
+        layout = rankfile.pack(self._rank_ranges())
+        limit = self._options.get('env_limit')
+        if limit is None:
+            limit = rankfile.ENV_LIMIT
+        encoded = rankfile.encode(layout)
+        if len(encoded) <= limit:
+            return {'WRAPRUN_LAYOUT': encoded}
+        self._write_file(layout)
+        return {'WRAPRUN_FILE': self._file.name}
+
     @property
     def env(self):
         """Return the dictionary of wraprun runtime environment variables."""
@@ -215,10 +246,44 @@ class Wraprun(object):
                 self._env = dict()
                 if not self._options.get('no_ld_preload', False):
                     self._env['LD_PRELOAD'] = os.environ['WRAPRUN_PRELOAD']
-                self._env['WRAPRUN_FILE'] = self._file.name
+                self._env.update(self._layout_env())
                 self._env['W_REDIRECT_OUTERR'] = '1'
                 self._env['W_IGNORE_SEGV'] = '1'
                 self._env['W_UNSET_PRELOAD'] = '1'
+                if self._options.get('scatter_params', False):
+                    self._env['W_SCATTER_PARAMS'] = '1'
+                if self._options.get('split_group', False):
+                    self._env['W_SPLIT_GROUP'] = '1'
+                if self._options.get('lazy_split', False):
+                    self._env['W_LAZY_SPLIT'] = '1'
+                if self._options.get('pmpi_chain', False):
+                    self._env['W_PMPI_CHAIN'] = '1'
+                if self._options.get('profile', False):
+                    self._env['W_PROFILE'] = '1'
+                if self._options.get('timeline_file') is not None:
+                    self._env['W_TIMELINE'] = os.path.abspath(
+                        self._options['timeline_file'])
+                if self._options.get('trace_prefix') is not None:
+                    self._env['W_TRACE'] = os.path.abspath(
+                        self._options['trace_prefix'])
+                if self._options.get('rusage_file') is not None:
+                    self._env['W_RUSAGE'] = os.path.abspath(
+                        self._options['rusage_file'])
+                if self._options.get('heartbeat') is not None:
+                    self._env['W_HEARTBEAT'] = str(self._options['heartbeat'])
+                if self._options.get('forward_outerr', False):
+                    self._env['W_FORWARD_OUTERR'] = '1'
+                if self._options.get('tag_outerr', False):
+                    self._env['W_TAG_OUTERR'] = '1'
+                if self._options.get('stage_dir') is not None:
+                    self._env['W_STAGE_OUTERR'] = self._options['stage_dir']
+                if self._options.get('compress_outerr', False):
+                    self._env['W_COMPRESS_OUTERR'] = '1'
+                if self._options.get('lazy_outerr', False):
+                    self._env['W_LAZY_OUTERR'] = '1'
+                if self._options.get('timing_file') is not None:
+                    self._env['W_TIMING_FILE'] = os.path.abspath(
+                        self._options['timing_file'])
             return self._env
         except KeyError as error:
             self._env = None
@@ -269,10 +334,10 @@ class Wraprun(object):
             for key, value in sorted(self.env.items()):
                 print('   ', key, "=", value, sep="")
             print('\n Internal state:\n   ', self.__repr__(), '\n', sep='')
-            self._file.file.seek(0)
             width = len(str(self._rank_and_color['rank']))
             print(' Tempfile contents:')
-            for line_number, line in enumerate(self._file.file.readlines()):
-                print('   {ln:0{width}d}|{line}'.format(
-                    ln=line_number, width=width, line=line[:-1]))
+            for rank_range in self._rank_ranges():
+                print('   {r0:0{width}d}-{r1:0{width}d}|{line}'.format(
+                    r0=rank_range.first_rank, r1=rank_range.last_rank,
+                    width=width, line=rank_range.string()))
             print("END WRAPRUN DEBUGGING INFO")
@@ -164,6 +164,159 @@ class GlobalOptions(OptionsBase):
                     'help': 'Disable setting LD_PRELOAD for advanced users.',
                     },
                 ),
+            Argument(
+                name='env_limit',
+                flags=['--w-env-limit'],
+                parser={
+                    'metavar': 'bytes',
+                    'type': int,
+                    'help': 'Largest encoded rank layout passed in the '
+                            'environment instead of a file',
+                    },
+                ),
+            Argument(
+                name='split_group',
+                flags=['--w-split-group'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Build task communicators from rank groups '
+                            'instead of splitting MPI_COMM_WORLD',
+                    },
+                ),
+            Argument(
+                name='lazy_split',
+                flags=['--w-lazy-split'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Defer creating single rank task communicators '
+                            'until first used',
+                    },
+                ),
+            Argument(
+                name='timing_file',
+                flags=['--w-timing'],
+                parser={
+                    'metavar': 'file',
+                    'help': 'Write a summary of task startup times to file',
+                    },
+                ),
+            Argument(
+                name='scatter_params',
+                flags=['--w-scatter'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Read rank parameters on rank 0 and scatter them',
+                    },
+                ),
+            Argument(
+                name='pmpi_chain',
+                flags=['--w-pmpi-chain'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Call PMPI tools preloaded after libsplit '
+                            'instead of the MPI library directly',
+                    },
+                ),
+            Argument(
+                name='profile',
+                flags=['--w-profile'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Write a per task profile of MPI calls '
+                            'beside its stdout/stderr',
+                    },
+                ),
+            Argument(
+                name='timeline_file',
+                flags=['--w-timeline'],
+                parser={
+                    'metavar': 'file',
+                    'help': 'Write the span of each task, the straggling '
+                            'task and idle core-hours per node to file',
+                    },
+                ),
+            Argument(
+                name='trace_prefix',
+                flags=['--w-trace'],
+                parser={
+                    'metavar': 'prefix',
+                    'help': 'Write a Chrome trace of the last MPI calls of '
+                            'each rank to prefix.<rank>.json',
+                    },
+                ),
+            Argument(
+                name='rusage_file',
+                flags=['--w-rusage'],
+                parser={
+                    'metavar': 'file',
+                    'help': 'Write the resource usage of each task to the '
+                            'CSV file',
+                    },
+                ),
+            Argument(
+                name='heartbeat',
+                flags=['--w-heartbeat'],
+                parser={
+                    'metavar': 'seconds',
+                    'type': float,
+                    'help': 'Update a status file beside each task\'s '
+                            'stdout/stderr every seconds',
+                    },
+                ),
+            Argument(
+                name='forward_outerr',
+                flags=['--w-forward-oe'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Write each task\'s stdout/stderr from one '
+                            'rank per node in large batches',
+                    },
+                ),
+            Argument(
+                name='tag_outerr',
+                flags=['--w-tag-oe'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Prefix each line of stdout/stderr with the '
+                            'task rank and time, writing whole lines',
+                    },
+                ),
+            Argument(
+                name='stage_dir',
+                flags=['--w-stage'],
+                parser={
+                    'metavar': 'dir',
+                    'help': 'Write stdout/stderr to the node-local dir, '
+                            'copying them out at MPI_Finalize',
+                    },
+                ),
+            Argument(
+                name='compress_outerr',
+                flags=['--w-oe-compress'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Gzip each task\'s stdout/stderr to .out.gz '
+                            'and .err.gz files',
+                    },
+                ),
+            Argument(
+                name='lazy_outerr',
+                flags=['--w-lazy-oe'],
+                parser={
+                    'action': FlagAction,
+                    'default': False,
+                    'help': 'Only create each task\'s stdout/stderr files '
+                            'once output is written to them',
+                    },
+                ),
             )
 
         aprun = ArgumentList(
@@ -0,0 +1,76 @@
+"""
+This module serializes rank runtime parameters into the indexed binary format
+read by libsplit from the file named in the WRAPRUN_FILE environment variable.
+
+The layout, with all integers little endian, is:
+
+    header  - 8 byte magic b'WRAPRUN\\0', uint32 format version, uint32 number
+              of ranks, uint32 number of rank ranges and uint32 padding.
+    ranges  - one (uint32 first rank, uint32 rank count, uint64 record offset)
+              entry per task split, sorted by first rank, so a rank can binary
+              search for its own record.
+    records - int32 color and three uint32 string lengths followed by the
+              NUL terminated working directory, stdout/stderr basename and
+              environment variable strings.
+
+The file size grows with the number of task splits rather than the number of
+ranks. libsplit still accepts the legacy one-line-per-rank text format when the
+magic is absent.
+
+Small layouts can skip the file entirely: encode() returns a compressed,
+base64 copy of the layout that libsplit decodes from the WRAPRUN_LAYOUT
+environment variable.
+"""
+
+import base64
+import struct
+import zlib
+
+MAGIC = b'WRAPRUN\0'
+VERSION = 2
+
+_HEADER = struct.Struct('<8sIIII')
+_RANGE = struct.Struct('<IIQ')
+_RECORD = struct.Struct('<iIII')
+_LENGTH = struct.Struct('<I')
+
+# Default size in bytes above which an encoded layout is written to a file
+# instead of being passed in the launcher environment.
+ENV_LIMIT = 16384
+
+
+def _encode(value):
+    """Return a NUL terminated bytes copy of a record string."""
+    return str(value).encode('utf-8') + b'\0'
+
+
+def pack(rank_ranges):
+    """Return the indexed binary rank parameter file contents for the iterable
+    of task.RankRange objects, given in rank order.
+    """
+    rank_ranges = list(rank_ranges)
+    ranges = []
+    records = []
+    rank_count = 0
+    position = _HEADER.size + _RANGE.size * len(rank_ranges)
+    for rank_range in rank_ranges:
+        first_rank, count, color, path, fname, env = rank_range.record()
+        strings = [_encode(path), _encode(fname), _encode(env)]
+        record = _RECORD.pack(
+            color, *[len(s) - 1 for s in strings]) + b''.join(strings)
+        ranges.append(_RANGE.pack(first_rank, count, position))
+        records.append(record)
+        position += len(record)
+        rank_count = max(rank_count, first_rank + count)
+
+    return b''.join(
+        [_HEADER.pack(MAGIC, VERSION, rank_count, len(ranges), 0)] +
+        ranges + records)
+
+
+def encode(layout):
+    """Return the zlib compressed layout, prefixed with its uncompressed
+    uint32 length, as a base64 string suitable for an environment variable.
+    """
+    compressed = _LENGTH.pack(len(layout)) + zlib.compress(layout, 9)
+    return base64.b64encode(compressed).decode('ascii')
@@ -1,7 +1,7 @@
 """
 The task module provides the following classes:
 
-    Rank      - for managing rank runtime parameters.
+    RankRange - for managing runtime parameters of a range of ranks.
     TaskError - for mananging exceptions in task module classes.
     TaskGroup - for processing and formatting MPMD mode task specs in the
                 wraprun API.
@@ -12,10 +12,10 @@ from .options import GROUP_OPTIONS
 from .instance import JOB_ID, INSTANCE_ID
 
 
-class Rank(object):
-    '''Information about ranks within an MPMD task group.
+class RankRange(object):
+    '''Information about a contiguous range of ranks within an MPMD task group.
 
-    Stores the CWD and color of an MPI rank.
+    Stores the CWD and color shared by every MPI rank of a task split.
     '''
     # Ordered tuple of keys in output file lines.
     FILE_CONTENT = (
@@ -26,9 +26,10 @@ class Rank(object):
 
     FILE_FORMAT = ' '.join(('{{{0}}}'.format(k) for k in FILE_CONTENT))
 
-    def __init__(self, rank, color, **kwargs):
+    def __init__(self, first_rank, count, color, **kwargs):
         '''Store data to be written to the rank parameters file.'''
-        self.rank = rank
+        self.first_rank = first_rank
+        self.count = count
         self._data = {
             'color': color,
             'path': './',
@@ -38,12 +39,25 @@ class Rank(object):
         self._data.update(kwargs)
 
     def __repr__(self):
-        """Return the representation of a Rank runtime data."""
-        return 'Rank({0}:{1})'.format(self.rank, self._data['color'])
+        """Return the representation of a RankRange runtime data."""
+        return 'RankRange({0}-{1}:{2})'.format(
+            self.first_rank, self.last_rank, self._data['color'])
+
+    @property
+    def last_rank(self):
+        '''Return the highest rank in the range.'''
+        return self.first_rank + self.count - 1
 
     def string(self):
         '''Return rank data string for writing to the rank parameters file.'''
-        return Rank.FILE_FORMAT.format(**self._data)
+        return RankRange.FILE_FORMAT.format(**self._data)
+
+    def record(self):
+        '''Return the (first_rank, count, color, path, fname, env) tuple stored
+        in the indexed rank parameters file.'''
+        return (self.first_rank, self.count, self._data['color'],
+                self._data['path'], self._data['fname'],
+                self._data.get('env', ''))
 
     @property
     def color(self):
@@ -69,7 +83,7 @@ class TaskGroup(object):
         respectively. Arguments are passed by name as keywords with wraprun API
         format values.
         """
-        self._ranks = []
+        self._rank_ranges = []
         self._first_color = first_color
         self.args = OrderedDict.fromkeys(
             GROUP_OPTIONS.wraprun.names +
@@ -77,20 +91,21 @@ class TaskGroup(object):
         for k in self.args:
             self.args[k] = kwargs.pop(k, GROUP_OPTIONS.get(k).default)
         self._balance()
-        self._set_ranks(first_rank, first_color)
+        self._set_rank_ranges(first_rank, first_color)
 
     def __repr__(self):
         format_string = "TaskGroup(r{r0}.c{c0}-r{r1}.c{c1}, exe='{exe}')"
-        return format_string.format(r0=self._ranks[0].rank,
-                                    c0=self._ranks[0].color,
-                                    r1=self._ranks[-1].rank,
-                                    c1=self._ranks[-1].color,
+        return format_string.format(r0=self._rank_ranges[0].first_rank,
+                                    c0=self._rank_ranges[0].color,
+                                    r1=self._rank_ranges[-1].last_rank,
+                                    c1=self._rank_ranges[-1].color,
                                     exe=self.args['exe'][0])
 
     @property
-    def ranks(self):
-        """Return a list of rank objects in this task group."""
-        return self._ranks
+    def rank_ranges(self):
+        """Return a list of rank range objects, one per split of this task
+        group."""
+        return self._rank_ranges
 
     def _balance(self):
         """Balances the split arguments by number of colors.
@@ -143,34 +158,33 @@ class TaskGroup(object):
         task group.
         """
         try:
-            rank = self._ranks[-1].rank
-            color = self._ranks[-1].color
+            rank = self._rank_ranges[-1].last_rank
+            color = self._rank_ranges[-1].color
         except IndexError:
             rank = None
             color = None
         return {'rank': rank, 'color': color}
 
-    def _set_ranks(self, first_rank, first_color):
-        """Populate the list of ranks given the specified number of processing
-        elements."""
-        ranks = []
+    def _set_rank_ranges(self, first_rank, first_color):
+        """Populate the list of rank ranges, one per split, given the specified
+        number of processing elements."""
+        rank_ranges = []
         rank_id = first_rank
         for i, pes_count in enumerate(self.args['pes']):
             color = first_color + i
             if pes_count is None:
                 raise TaskError('Invalid PES')
-            for _ in range(pes_count):
-                rank = Rank(rank_id, color,
-                            path=self.args['cd'][i],
-                            fname=self.args['oe'][i])
-                ranks.append(rank)
-                rank_id += 1
-        self._ranks = ranks
+            rank_ranges.append(RankRange(rank_id, pes_count, color,
+                                         path=self.args['cd'][i],
+                                         fname=self.args['oe'][i]))
+            rank_id += pes_count
+        self._rank_ranges = rank_ranges
 
     def file_lines(self):
         """Generator for lines written to rank runtime parameter file."""
-        for rank in self._ranks:
-            yield rank.string()
+        for rank_range in self._rank_ranges:
+            for _ in range(rank_range.count):
+                yield rank_range.string()
 
     def cli_args(self):
         """Return a list of aprun-format CLI argument strings that represent
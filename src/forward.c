@@ -0,0 +1,654 @@
+/*
+  W_FORWARD_OUTERR and W_TAG_OUTERR replace the freopen of a rank's stdout and
+  stderr onto its color's .out and .err files with pipes, drained by a pump
+  thread that passes on whole lines. Lines written a piece at a time, or by a
+  code that made stdout unbuffered, are then written out whole, without a
+  write to the filesystem for each piece.
+
+  W_FORWARD_OUTERR forwards the lines of the ranks of a color on a node to one
+  aggregator, instead of every rank appending to the color's files on the
+  shared filesystem. The pumps pass them on to a FIFO created under TMPDIR,
+  /tmp by default, by the first rank of the color on the node. A thread on that
+  rank reads the FIFO and batches each stream, writing it to the color's file
+  with one large write once FORWARD_BUFFER_SIZE bytes are held or
+  FORWARD_FLUSH_INTERVAL seconds after the last write. Records of up to
+  PIPE_BUF bytes reach the FIFO whole, so lines of different ranks never mix,
+  only lines longer than a record may be split. The aggregator skips past a
+  bad record to the next record's magic rather than stop draining the FIFO,
+  and should a write to the FIFO fail the pump writes the rank's output to the
+  color's uncompressed files itself.
+
+  W_COMPRESS_OUTERR has the aggregator write each batch as a gzip member to
+  the color's .out.gz and .err.gz files, which the batches of the color's
+  aggregators concatenate to, so the compression runs on the aggregator thread
+  rather than the application's. It forwards output even without
+  W_FORWARD_OUTERR. A file created for a stream given no output holds an empty
+  member, as gzip rejects an empty file.
+
+  W_LAZY_OUTERR creates the color's files when output is first written to
+  them rather than at MPI_Init, so a task that never writes to stderr, say,
+  has no .err file and makes no create on the shared filesystem.
+
+  W_TAG_OUTERR prefixes each line with the rank's color rank and the wall
+  clock time it was read by the pump. Without W_FORWARD_OUTERR the pump writes
+  the lines it reads to the color's files, opened O_APPEND, in single writes so
+  lines of ranks sharing the files stay whole.
+
+  MPI_Finalize closes the rank's pipes and waits for its pump to drain them.
+  The aggregator writes out what it holds once every rank of the color on its
+  node has done so. A process started by a rank inherits its stdout/stderr, and
+  holds MPI_Finalize until it exits.
+*/
+
+#define _GNU_SOURCE // pipe2, memrchr, asprintf
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <zlib.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+#define FORWARD_BUFFER_SIZE (1 << 20)
+#define FORWARD_FLUSH_INTERVAL 1.0
+#define PUMP_BUFFER_SIZE 65536
+#define TAG_SIZE 64
+#define COMPRESS_LEVEL Z_BEST_SPEED
+
+enum { FORWARD_OUT, FORWARD_ERR, FORWARD_STREAMS };
+static const char *const STREAM_SUFFIXES[FORWARD_STREAMS] = {"out", "err"};
+static const int STREAM_FDS[FORWARD_STREAMS] = {STDOUT_FILENO, STDERR_FILENO};
+
+// A FIFO record is a header followed by length bytes of the stream, the magic
+// lets the aggregator find the next record after a bad one
+#define RECORD_MAGIC 0x77726f65
+typedef struct {
+  uint32_t magic;
+  int32_t stream;
+  int32_t length;
+} RecordHeader;
+
+#define RECORD_DATA_SIZE (PIPE_BUF - sizeof(RecordHeader))
+
+static int forward_enabled = 0;
+static int forward_aggregator = 0;
+static int forward_compress = 0;
+
+// Color rank prefixed to lines by W_TAG_OUTERR, -1 if untagged
+static int tag_rank = -1;
+
+// The read ends of the rank's stdout/stderr pipes, and the original
+// descriptors they replaced, restored by MPI_Finalize
+static int pipe_fds[FORWARD_STREAMS] = {-1, -1};
+static int saved_fds[FORWARD_STREAMS] = {-1, -1};
+
+// The FIFO to the aggregator, -1 if the pump writes to the files itself
+static int fifo_write_fd = -1;
+
+// Should a write to the FIFO fail, the pump appends the rank's output to the
+// color's uncompressed files itself, opened from direct_names on first use
+static int aggregator_lost = 0;
+static char *direct_names[FORWARD_STREAMS] = {NULL, NULL};
+static int direct_fds[FORWARD_STREAMS] = {-1, -1};
+
+// The color's files, opened by the aggregator or else by every rank, with
+// W_LAZY_OUTERR from file_names on their first write
+static int file_fds[FORWARD_STREAMS] = {-1, -1};
+static char *file_names[FORWARD_STREAMS] = {NULL, NULL};
+
+// Aggregator only
+static int fifo_read_fd = -1;
+static char *batches[FORWARD_STREAMS] = {NULL, NULL};
+static size_t batch_lengths[FORWARD_STREAMS] = {0, 0};
+static z_stream deflate_streams[FORWARD_STREAMS];
+static unsigned char *compressed = NULL;
+static int members_written[FORWARD_STREAMS] = {0, 0};
+static size_t compressed_size = 0;
+
+static pthread_t pump_thread;
+static pthread_t aggregator_thread;
+
+static double WallTime() {
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + 1.0e-6*time.tv_usec;
+}
+
+// Open the stream's file on its first write, returns 0 if it can't be
+static int OpenLazyStream(const int stream) {
+  if(!file_names[stream])
+    return 0;
+
+  file_fds[stream] = open(file_names[stream], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+  if(file_fds[stream] < 0)
+    dprintf(saved_fds[FORWARD_ERR], "ERROR OPENING FORWARDED FILE %s: %s\n",
+            file_names[stream], strerror(errno));
+
+  // Output is dropped after a failed open rather than retried
+  free(file_names[stream]);
+  file_names[stream] = NULL;
+  return file_fds[stream] >= 0;
+}
+
+// Write all of data to fd, a file of the stream
+static void WriteAll(const int fd, const int stream, const char *const data,
+                     const size_t length) {
+  size_t written = 0;
+  while(written < length) {
+    const ssize_t count = write(fd, data + written, length - written);
+    if(count < 0) {
+      if(errno == EINTR)
+        continue;
+      dprintf(saved_fds[FORWARD_ERR], "ERROR WRITING FORWARDED %s: %s\n",
+              STREAM_SUFFIXES[stream], strerror(errno));
+      return;
+    }
+    written += count;
+  }
+}
+
+// Write all of data to the stream's file
+static void WriteStream(const int stream, const char *const data, const size_t length) {
+  if(file_fds[stream] < 0 && !OpenLazyStream(stream))
+    return;
+  WriteAll(file_fds[stream], stream, data, length);
+}
+
+// Write data to the stream's file without the aggregator
+static void WriteDirect(const int stream, const char *const data, const size_t length) {
+  if(direct_fds[stream] < 0 && direct_names[stream]) {
+    direct_fds[stream] = open(direct_names[stream], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                              0666);
+    if(direct_fds[stream] < 0)
+      dprintf(saved_fds[FORWARD_ERR], "ERROR OPENING FORWARDED FILE %s: %s\n",
+              direct_names[stream], strerror(errno));
+    free(direct_names[stream]);
+    direct_names[stream] = NULL;
+  }
+  if(direct_fds[stream] >= 0)
+    WriteAll(direct_fds[stream], stream, data, length);
+}
+
+// Write a record to the FIFO, atomically as it is no larger than PIPE_BUF,
+// returns 0 on success
+static int WriteRecord(const int stream, const char *const data, const size_t length) {
+  char record[PIPE_BUF];
+  const RecordHeader header = {RECORD_MAGIC, stream, (int32_t)length};
+  memcpy(record, &header, sizeof(header));
+  memcpy(record + sizeof(header), data, length);
+
+  ssize_t count;
+  do {
+    count = write(fifo_write_fd, record, sizeof(header) + length);
+  } while(count < 0 && errno == EINTR);
+  return count == (ssize_t)(sizeof(header) + length) ? 0 : -1;
+}
+
+// Pass data on to the FIFO as records ending at a line end where possible,
+// or else straight to the stream's file
+static void PassOn(const int stream, const char *const data, const size_t length) {
+  if(aggregator_lost) {
+    WriteDirect(stream, data, length);
+    return;
+  }
+  if(fifo_write_fd < 0) {
+    WriteStream(stream, data, length);
+    return;
+  }
+
+  size_t sent = 0;
+  while(sent < length) {
+    size_t count = length - sent < RECORD_DATA_SIZE ? length - sent : RECORD_DATA_SIZE;
+    const char *const newline = memrchr(data + sent, '\n', count);
+    if(newline && count == RECORD_DATA_SIZE)
+      count = newline - (data + sent) + 1;
+
+    if(WriteRecord(stream, data + sent, count)) {
+      dprintf(saved_fds[FORWARD_ERR], "ERROR FORWARDING %s TO AGGREGATOR: %s, "
+              "WRITING IT DIRECTLY\n", STREAM_SUFFIXES[stream], strerror(errno));
+      close(fifo_write_fd);
+      fifo_write_fd = -1;
+      aggregator_lost = 1;
+      WriteDirect(stream, data + sent, length - sent);
+      return;
+    }
+    sent += count;
+  }
+}
+
+// Pass on data, at most PUMP_BUFFER_SIZE bytes, with W_TAG_OUTERR tagging the
+// start of each line. line_start tracks whether the stream's next byte starts
+// a line, as a line longer than the pump's buffer is passed on in pieces
+static void PassLines(const int stream, const char *data, size_t length, int *const line_start) {
+  if(tag_rank < 0) {
+    PassOn(stream, data, length);
+    return;
+  }
+
+  char tagged[PUMP_BUFFER_SIZE + TAG_SIZE];
+  size_t held = 0;
+  char tag[TAG_SIZE];
+  const int tag_length = snprintf(tag, TAG_SIZE, "[%d %.3f] ", tag_rank, WallTime());
+
+  while(length > 0) {
+    const char *const newline = memchr(data, '\n', length);
+    const size_t count = newline ? (size_t)(newline - data) + 1 : length;
+    if(held + tag_length + count > sizeof(tagged)) {
+      PassOn(stream, tagged, held);
+      held = 0;
+    }
+
+    if(*line_start) {
+      memcpy(tagged + held, tag, tag_length);
+      held += tag_length;
+    }
+    memcpy(tagged + held, data, count);
+    held += count;
+    *line_start = newline != NULL;
+
+    data += count;
+    length -= count;
+  }
+
+  if(held > 0)
+    PassOn(stream, tagged, held);
+}
+
+static void CloseStreamFile(const int stream) {
+  if(file_fds[stream] >= 0)
+    close(file_fds[stream]);
+  free(file_names[stream]);
+  file_names[stream] = NULL;
+}
+
+static void *Pump(void *arg) {
+  // A write to the FIFO of an aggregator that has stopped then fails with EPIPE
+  // rather than killing the rank
+  sigset_t pipe_signal;
+  sigemptyset(&pipe_signal);
+  sigaddset(&pipe_signal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+
+  char buffers[FORWARD_STREAMS][PUMP_BUFFER_SIZE];
+  size_t held[FORWARD_STREAMS] = {0, 0};
+  int line_start[FORWARD_STREAMS] = {1, 1};
+
+  struct pollfd fds[FORWARD_STREAMS];
+  int i;
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    fds[i].fd = pipe_fds[i];
+    fds[i].events = POLLIN;
+  }
+
+  int open_streams = FORWARD_STREAMS;
+  while(open_streams > 0) {
+    if(poll(fds, FORWARD_STREAMS, -1) < 0) {
+      if(errno == EINTR)
+        continue;
+      break;
+    }
+
+    for(i=0; i<FORWARD_STREAMS; i++) {
+      if(fds[i].fd < 0 || !fds[i].revents)
+        continue;
+
+      const ssize_t count = read(fds[i].fd, buffers[i] + held[i], PUMP_BUFFER_SIZE - held[i]);
+      if(count < 0 && errno == EINTR)
+        continue;
+      const int closed = count <= 0;
+      if(!closed)
+        held[i] += count;
+
+      // Whole lines, unless the stream is closed or a line fills the buffer
+      size_t pass = held[i];
+      if(!closed && held[i] < PUMP_BUFFER_SIZE) {
+        const char *const newline = memrchr(buffers[i], '\n', held[i]);
+        pass = newline ? (size_t)(newline - buffers[i]) + 1 : 0;
+      }
+
+      if(pass > 0) {
+        PassLines(i, buffers[i], pass, &line_start[i]);
+        memmove(buffers[i], buffers[i] + pass, held[i] - pass);
+        held[i] -= pass;
+      }
+
+      if(closed) {
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        open_streams--;
+      }
+    }
+  }
+
+  // The aggregator's files are closed by its own thread
+  if(fifo_write_fd >= 0)
+    close(fifo_write_fd);
+  else if(!aggregator_lost) {
+    for(i=0; i<FORWARD_STREAMS; i++)
+      CloseStreamFile(i);
+  }
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    if(direct_fds[i] >= 0)
+      close(direct_fds[i]);
+    free(direct_names[i]);
+  }
+  return NULL;
+}
+
+// Write the stream's batch as a whole gzip member, so the members the
+// aggregators append make a valid gzip file
+static void CompressBatch(const int stream) {
+  z_stream *const deflate_stream = &deflate_streams[stream];
+  deflate_stream->next_in = (Bytef*)batches[stream];
+  deflate_stream->avail_in = batch_lengths[stream];
+  deflate_stream->next_out = compressed;
+  deflate_stream->avail_out = compressed_size;
+  if(deflate(deflate_stream, Z_FINISH) == Z_STREAM_END) {
+    WriteStream(stream, (char*)compressed, compressed_size - deflate_stream->avail_out);
+    members_written[stream] = 1;
+  }
+  else
+    dprintf(saved_fds[FORWARD_ERR], "ERROR COMPRESSING FORWARDED %s\n", STREAM_SUFFIXES[stream]);
+  deflateReset(deflate_stream);
+}
+
+// Write the stream's batch, with W_COMPRESS_OUTERR as a gzip member
+static void FlushStream(const int stream) {
+  if(batch_lengths[stream] == 0)
+    return;
+
+  if(forward_compress)
+    CompressBatch(stream);
+  else
+    WriteStream(stream, batches[stream], batch_lengths[stream]);
+  batch_lengths[stream] = 0;
+}
+
+// Read length bytes of the FIFO, returns 0 once every rank has closed it
+static int ReadFifo(void *const data, const size_t length) {
+  size_t done = 0;
+  while(done < length) {
+    const ssize_t count = read(fifo_read_fd, (char*)data + done, length - done);
+    if(count < 0 && errno == EINTR)
+      continue;
+    if(count <= 0)
+      return 0;
+    done += count;
+  }
+  return 1;
+}
+
+static int ValidHeader(const RecordHeader *const header) {
+  return header->magic == RECORD_MAGIC && header->stream >= 0 &&
+         header->stream < FORWARD_STREAMS && header->length >= 0 &&
+         header->length <= (int32_t)RECORD_DATA_SIZE;
+}
+
+// Read the next record header, skipping a byte at a time past a bad record to
+// the next valid header so the FIFO is still drained, returns 0 once every
+// rank has closed the FIFO
+static int ReadHeader(RecordHeader *const header) {
+  char *const bytes = (char*)header;
+  if(!ReadFifo(bytes, sizeof(RecordHeader)))
+    return 0;
+
+  size_t skipped = 0;
+  while(!ValidHeader(header)) {
+    memmove(bytes, bytes + 1, sizeof(RecordHeader) - 1);
+    if(!ReadFifo(bytes + sizeof(RecordHeader) - 1, 1))
+      return 0;
+    skipped++;
+  }
+  if(skipped > 0)
+    dprintf(saved_fds[FORWARD_ERR], "ERROR READING FORWARDED OUTPUT: SKIPPED %zu BYTES\n",
+            skipped);
+  return 1;
+}
+
+static void *Aggregate(void *arg) {
+  struct pollfd fifo = {fifo_read_fd, POLLIN, 0};
+  char data[RECORD_DATA_SIZE];
+  double last_flush = Now();
+  int i;
+
+  for(;;) {
+    if(Now() - last_flush >= FORWARD_FLUSH_INTERVAL) {
+      for(i=0; i<FORWARD_STREAMS; i++)
+        FlushStream(i);
+      last_flush = Now();
+    }
+
+    const int ready = poll(&fifo, 1, (int)(1000*FORWARD_FLUSH_INTERVAL));
+    if(ready < 0 && errno == EINTR)
+      continue;
+    if(ready < 0)
+      break;
+    if(ready == 0)
+      continue;
+
+    RecordHeader header;
+    if(!ReadHeader(&header))
+      break;
+    if(!ReadFifo(data, header.length))
+      break;
+
+    if(batch_lengths[header.stream] + header.length > FORWARD_BUFFER_SIZE)
+      FlushStream(header.stream);
+    memcpy(batches[header.stream] + batch_lengths[header.stream], data, header.length);
+    batch_lengths[header.stream] += header.length;
+  }
+
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    FlushStream(i);
+    // zcat rejects an empty file, so a file created for a stream given no
+    // output holds an empty member
+    if(forward_compress && file_fds[i] >= 0 && !members_written[i])
+      CompressBatch(i);
+    CloseStreamFile(i);
+    free(batches[i]);
+    if(forward_compress)
+      deflateEnd(&deflate_streams[i]);
+  }
+  free(compressed);
+  close(fifo_read_fd);
+  return NULL;
+}
+
+// Open the color's files, or with W_LAZY_OUTERR name them for their first write
+static void OpenStreamFiles(const char *const out_err_filename) {
+  const int lazy = getenv("W_LAZY_OUTERR") != NULL;
+  char cwd[2048];
+  if(lazy && !getcwd(cwd, sizeof(cwd)))
+    EXIT_PRINT("Error getting working directory: %s\n", strerror(errno));
+
+  int i;
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    char suffix[8];
+    snprintf(suffix, sizeof(suffix), forward_compress ? "%s.gz" : "%s", STREAM_SUFFIXES[i]);
+    char filename[2048];
+    StreamFileName(filename, sizeof(filename), out_err_filename, suffix);
+
+    if(!lazy) {
+      file_fds[i] = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+      if(file_fds[i] < 0)
+        EXIT_PRINT("Error opening %s: %s\n", filename, strerror(errno));
+      continue;
+    }
+
+    // The application may change directory before its first write
+    const int length = filename[0] == '/' ? asprintf(&file_names[i], "%s", filename)
+                                          : asprintf(&file_names[i], "%s/%s", cwd, filename);
+    if(length < 0)
+      EXIT_PRINT("Error allocating forwarded file name!\n");
+  }
+}
+
+// Name the color's uncompressed files, unstaged, for the pump to write should
+// the aggregator be lost
+static void NameDirectFiles(const char *const out_err_filename) {
+  char cwd[2048];
+  if(out_err_filename[0] != '/' && !getcwd(cwd, sizeof(cwd)))
+    EXIT_PRINT("Error getting working directory: %s\n", strerror(errno));
+
+  int i;
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    const int length = out_err_filename[0] == '/'
+      ? asprintf(&direct_names[i], "%s.%s", out_err_filename, STREAM_SUFFIXES[i])
+      : asprintf(&direct_names[i], "%s/%s.%s", cwd, out_err_filename, STREAM_SUFFIXES[i]);
+    if(length < 0)
+      EXIT_PRINT("Error allocating forwarded file name!\n");
+  }
+}
+
+// Open the color's files, and a FIFO named fifo_name in the new directory
+// fifo_dir
+static void StartAggregator(const char *const out_err_filename, char *const fifo_dir,
+                            char *const fifo_name, const size_t size) {
+  OpenStreamFiles(out_err_filename);
+
+  int i;
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    batches[i] = malloc(FORWARD_BUFFER_SIZE);
+    if(!batches[i])
+      EXIT_PRINT("Error allocating output forwarding memory!\n");
+
+    // A window of 15 bits plus 16 writes a gzip header and trailer
+    if(forward_compress) {
+      memset(&deflate_streams[i], 0, sizeof(z_stream));
+      if(deflateInit2(&deflate_streams[i], COMPRESS_LEVEL, Z_DEFLATED, 15 + 16, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK)
+        EXIT_PRINT("Error initializing output compression!\n");
+      compressed_size = deflateBound(&deflate_streams[i], FORWARD_BUFFER_SIZE);
+    }
+  }
+
+  if(forward_compress) {
+    compressed = malloc(compressed_size);
+    if(!compressed)
+      EXIT_PRINT("Error allocating output compression memory!\n");
+  }
+
+  const char *const tmp_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  snprintf(fifo_dir, size, "%s/wraprun.XXXXXX", tmp_dir);
+  if(!mkdtemp(fifo_dir))
+    EXIT_PRINT("Error creating %s: %s\n", fifo_dir, strerror(errno));
+  snprintf(fifo_name, size, "%s/fifo", fifo_dir);
+  if(mkfifo(fifo_name, 0600))
+    EXIT_PRINT("Error creating %s: %s\n", fifo_name, strerror(errno));
+
+  // Opened before any rank writes, so reads only end once every rank closes it
+  fifo_read_fd = open(fifo_name, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if(fifo_read_fd < 0)
+    EXIT_PRINT("Error opening %s: %s\n", fifo_name, strerror(errno));
+}
+
+// Elect the first rank of color on the node as its aggregator and open the
+// aggregator's FIFO, collective over MPI_COMM_WORLD
+static void ConnectAggregator(const char *const out_err_filename, const int color) {
+  MPI_Comm node_comm, forward_comm;
+  int err = PMPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                                 &node_comm);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to split node communicator: %d!\n", err);
+  err = PMPI_Comm_split(node_comm, color, 0, &forward_comm);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to split output forwarding communicator: %d!\n", err);
+  PMPI_Comm_free(&node_comm);
+
+  int forward_rank;
+  PMPI_Comm_rank(forward_comm, &forward_rank);
+  forward_aggregator = forward_rank == 0;
+
+  char fifo_dir[PATH_MAX];
+  char fifo_name[PATH_MAX];
+  if(forward_aggregator)
+    StartAggregator(out_err_filename, fifo_dir, fifo_name, sizeof(fifo_name));
+
+  PMPI_Bcast(fifo_name, sizeof(fifo_name), MPI_CHAR, 0, forward_comm);
+  fifo_write_fd = open(fifo_name, O_WRONLY | O_CLOEXEC);
+  if(fifo_write_fd < 0)
+    EXIT_PRINT("Error opening %s: %s\n", fifo_name, strerror(errno));
+
+  // Once every rank holds the FIFO open it needs no name
+  PMPI_Barrier(forward_comm);
+  PMPI_Comm_free(&forward_comm);
+
+  if(forward_aggregator) {
+    unlink(fifo_name);
+    rmdir(fifo_dir);
+    fcntl(fifo_read_fd, F_SETFL, fcntl(fifo_read_fd, F_GETFL) & ~O_NONBLOCK);
+
+    err = pthread_create(&aggregator_thread, NULL, Aggregate, NULL);
+    if(err)
+      EXIT_PRINT("Error starting output aggregator thread: %s\n", strerror(err));
+  }
+}
+
+// Replace the rank's stdout/stderr with pipes pumped to the color's files,
+// through the node's aggregator of color with W_FORWARD_OUTERR or
+// W_COMPRESS_OUTERR, collective over MPI_COMM_WORLD
+void ForwardStdOutErr(const char *const out_err_filename, const int color,
+                      const int color_rank) {
+  if(getenv("W_TAG_OUTERR"))
+    tag_rank = color_rank;
+  forward_compress = getenv("W_COMPRESS_OUTERR") != NULL;
+
+  fflush(stdout);
+  fflush(stderr);
+  int i;
+  for(i=0; i<FORWARD_STREAMS; i++)
+    saved_fds[i] = fcntl(STREAM_FDS[i], F_DUPFD_CLOEXEC, 0);
+
+  if(getenv("W_FORWARD_OUTERR") || forward_compress) {
+    NameDirectFiles(out_err_filename);
+    ConnectAggregator(out_err_filename, color);
+  }
+  else
+    OpenStreamFiles(out_err_filename);
+
+  for(i=0; i<FORWARD_STREAMS; i++) {
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC))
+      EXIT_PRINT("Error creating %s pipe: %s\n", STREAM_SUFFIXES[i], strerror(errno));
+    dup2(fds[1], STREAM_FDS[i]);
+    close(fds[1]);
+    pipe_fds[i] = fds[0];
+  }
+
+  const int err = pthread_create(&pump_thread, NULL, Pump, NULL);
+  if(err)
+    EXIT_PRINT("Error starting output pump thread: %s\n", strerror(err));
+
+  forward_enabled = 1;
+}
+
+// Close the rank's pipes, restoring its original stdout/stderr, and wait for
+// the forwarded output to be written
+void StopForwarding() {
+  if(!forward_enabled)
+    return;
+  forward_enabled = 0;
+
+  fflush(stdout);
+  fflush(stderr);
+  int i;
+  for(i=0; i<FORWARD_STREAMS; i++)
+    dup2(saved_fds[i], STREAM_FDS[i]);
+
+  pthread_join(pump_thread, NULL);
+  if(forward_aggregator)
+    pthread_join(aggregator_thread, NULL);
+
+  for(i=0; i<FORWARD_STREAMS; i++)
+    close(saved_fds[i]);
+}
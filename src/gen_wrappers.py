@@ -0,0 +1,339 @@
+#!/usr/bin/env python
+"""
+Generates the libsplit MPI wrappers from a list of MPI prototypes.
+
+Each prototype line of the input, such as
+
+    int MPI_Barrier(MPI_Comm comm)
+
+becomes a wrapper that passes every MPI_Comm argument through GetCorrectComm()
+before calling the next implementation of the routine. That is PMPI_Barrier
+unless ChainNextMPI() has pointed it at the next MPI_Barrier, e.g. a PMPI tool
+preloaded after libsplit. While split_instrument is set the call is also
+timed and passed, with the size of its message, to InstrumentCall(). Lines
+starting with '#' are copied through unchanged so routines may be guarded by
+MPI version or implementation, blank lines and lines starting with '//' are
+skipped.
+
+With --fortran the Fortran bindings are generated instead: mpi_barrier_ with
+its mpi_barrier and mpi_barrier__ aliases, plus the mpi_f08 _f08 and _f08ts
+entry points. These swap the Fortran MPI_COMM_WORLD handle through
+GetCorrectFortranComm() and call the MPI library's own Fortran PMPI routine, or
+the next Fortran entry point once ChainNextFortranMPI() has run. The PMPI
+routines are weak references, as libraries define only some of the bindings,
+and one that is missing is looked up with dlsym() on the first call. Large count
+and MPIX routines have no Fortran binding here and are skipped.
+
+Usage: gen_wrappers.py [--fortran] mpi_prototypes.txt output.c
+"""
+
+import re
+import sys
+
+LINE_WIDTH = 100
+
+HEADER = """\
+// Generated by gen_wrappers.py from {source}, do not edit
+
+#define _GNU_SOURCE // RTLD_NEXT, must define this before ANY standard header
+#include <dlfcn.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "split.h"
+#include "print_macros.h"
+
+// Point next_name at the next definition of name, if there is one
+#define CHAIN_NEXT(name) do {{ \\
+  void *next = dlsym(RTLD_NEXT, #name); \\
+  if(next) \\
+    next_##name = next; \\
+}} while(0)
+
+// Index of each wrapped routine passed to InstrumentCall(), the C and Fortran
+// bindings of a routine share an index
+enum {{
+{routines}
+  ROUTINE_COUNT
+}};
+"""
+
+FORTRAN_NEXT = """\
+// Point a Fortran binding's next_name, NULL if the MPI library doesn't define
+// its weak PMPI symbol, at the PMPI or else the MPI entry point found after
+// libsplit, or fail naming the routine
+#define FORTRAN_NEXT(name, pmpi_name) do { \\
+  if(__builtin_expect(!next_##name, 0)) { \\
+    next_##name = dlsym(RTLD_NEXT, #pmpi_name); \\
+    if(!next_##name) \\
+      next_##name = dlsym(RTLD_NEXT, #name); \\
+    if(!next_##name) \\
+      EXIT_PRINT("Fortran " #name " not found in the MPI library!\\n"); \\
+  } \\
+} while(0)
+"""
+
+NAMES = """\
+const char *const split_routine_names[] = {{
+{names}
+}};
+const unsigned char split_routine_kinds[] = {{
+{kinds}
+}};
+const int split_routine_count = ROUTINE_COUNT;
+"""
+
+# Collective operations, also matched with an I prefix or _init suffix
+_COLLECTIVES = ('Barrier', 'Bcast', 'Gather', 'Gatherv', 'Scatter', 'Scatterv', 'Allgather',
+                'Allgatherv', 'Alltoall', 'Alltoallv', 'Alltoallw', 'Reduce', 'Allreduce',
+                'Reduce_scatter', 'Reduce_scatter_block', 'Scan', 'Exscan',
+                'Neighbor_allgather', 'Neighbor_allgatherv', 'Neighbor_alltoall',
+                'Neighbor_alltoallv', 'Neighbor_alltoallw')
+
+CHAIN = """\
+// Resolve the next implementation of every wrapped routine, e.g. a PMPI tool
+// preloaded after libsplit, in place of calling PMPI directly
+void {function}(void) {{
+{body}
+}}
+"""
+
+_PROTOTYPE = re.compile(r'^(\w+)\s+(P?MPIX?_\w+)\s*\((.*)\)\s*;?$')
+_NAME = re.compile(r'(\w+)\s*(\[\s*\])*$')
+
+# void * parameters that are addresses or attribute values in Fortran rather
+# than choice buffers
+_NOT_CHOICE = ('attribute_val', 'baseptr', 'buffer_addr')
+
+
+class Prototype(object):
+    """A parsed MPI routine prototype."""
+
+    def __init__(self, line):
+        match = _PROTOTYPE.match(line)
+        if not match:
+            raise ValueError("Unparsable prototype: " + line)
+        self.return_type, self.name, params = match.groups()
+        self.params = [p.strip() for p in params.split(',') if p.strip()]
+        if self.params == ['void']:
+            self.params = []
+        self.args = [self._arg_name(p) for p in self.params]
+
+    @staticmethod
+    def _arg_name(param):
+        match = _NAME.search(param)
+        if not match:
+            raise ValueError("Unnamed parameter: " + param)
+        return match.group(1)
+
+    def comm_args(self):
+        """Names of the arguments passed as an MPI_Comm by value."""
+        return [a for p, a in zip(self.params, self.args)
+                if re.match(r'^MPI_Comm\s+\w+$', p)]
+
+    def string_args(self):
+        """Names of the character arguments, each passed a hidden length by
+        Fortran."""
+        return [a for p, a in zip(self.params, self.args)
+                if re.match(r'^(const\s+)?char\b', p)]
+
+    def has_choice_buffer(self):
+        return any(re.match(r'^(const\s+)?void\s*\*\s*\w+$', p) and a not in _NOT_CHOICE
+                   for p, a in zip(self.params, self.args))
+
+    def message_args(self):
+        """Names of the count and datatype arguments giving the size of the
+        message sent, or received, or None."""
+        for count, datatype in (('count', 'datatype'), ('sendcount', 'sendtype')):
+            if count in self.args and datatype in self.args:
+                return count, datatype
+        return None
+
+    def kind(self):
+        """ROUTINE_COLLECTIVE or ROUTINE_P2P for routines moving a message
+        described by message_args(), else ROUTINE_OTHER."""
+        if not self.message_args():
+            return 'ROUTINE_OTHER'
+        operation = re.sub(r'(_init)?(_c)?$', '', self.name[len('MPI_'):])
+        if operation in _COLLECTIVES or (operation.startswith('I') and
+                                         operation[1:].capitalize() in _COLLECTIVES):
+            return 'ROUTINE_COLLECTIVE'
+        return 'ROUTINE_P2P'
+
+    def has_fortran_binding(self):
+        return not self.name.startswith('MPIX_') and not self.name.endswith('_c')
+
+    def pmpi_name(self):
+        return 'P' + self.name
+
+
+def wrap_call(prefix, items, suffix, indent=''):
+    """Join items after prefix, breaking lines before LINE_WIDTH and aligning
+    continuation lines with the opening parenthesis."""
+    lines = []
+    line = indent + prefix
+    align = ' ' * len(line)
+    for i, item in enumerate(items):
+        text = item + (', ' if i < len(items) - 1 else '')
+        if i > 0 and len(line) + len(text.rstrip()) > LINE_WIDTH:
+            lines.append(line.rstrip())
+            line = align
+        line += text
+    lines.append(line + suffix)
+    return '\n'.join(lines)
+
+
+def wrapper(prototype):
+    """Return the C source of the wrapper for prototype."""
+    comms = prototype.comm_args()
+    args = ['correct_' + a if a in comms else a for a in prototype.args]
+
+    message = prototype.message_args() or ('0', 'MPI_DATATYPE_NULL')
+
+    body = ['  DEBUG_PRINT("Wrapped!\\n");', '']
+    for comm in comms:
+        body.append('  MPI_Comm correct_%s = GetCorrectComm(%s);' % (comm, comm))
+    if comms:
+        body.append('')
+    body += ['  if(__builtin_expect(split_instrument, 0)) {',
+             '    const double start = Now();',
+             wrap_call('const %s err = next_%s(' % (prototype.return_type, prototype.name),
+                       args, ');', '    '),
+             '    InstrumentCall(ROUTINE_%s, start, %s, %s);' % ((prototype.name,) + message),
+             '    return err;',
+             '  }',
+             wrap_call('return next_%s(' % prototype.name, args, ');', '  ')]
+
+    next_pointer = 'static __typeof__(%s) *next_%s = %s;' % (
+        prototype.pmpi_name(), prototype.name, prototype.pmpi_name())
+    signature = wrap_call('%s %s(' % (prototype.return_type, prototype.name),
+                          prototype.params or ['void'], ') {')
+    return '\n'.join([next_pointer, signature] + body + ['}', ''])
+
+
+def fortran_wrapper(prototype, name, pmpi_name, hidden_lengths, aliases=()):
+    """Return the C source of a Fortran binding wrapper for prototype.
+
+    Fortran passes every argument by reference followed by ierror, the comm
+    handles are read, translated and passed on by reference. Non bind(C)
+    bindings also append the hidden lengths of character arguments.
+    """
+    comms = prototype.comm_args()
+    params = ['MPI_Fint *%s' % a if a in comms else 'void *%s' % a for a in prototype.args]
+    params.append('MPI_Fint *ierror')
+    args = ['&correct_' + a if a in comms else a for a in prototype.args]
+    args.append('ierror')
+    if hidden_lengths:
+        params += ['size_t %s_length' % a for a in prototype.string_args()]
+        args += ['%s_length' % a for a in prototype.string_args()]
+
+    # Fortran passes the count and datatype handle by reference
+    message = ('0', 'MPI_DATATYPE_NULL')
+    if prototype.message_args():
+        message = ('*(MPI_Fint *)%s' % prototype.message_args()[0],
+                   'MPI_Type_f2c(*(MPI_Fint *)%s)' % prototype.message_args()[1])
+
+    body = ['  DEBUG_PRINT("Wrapped!\\n");', '',
+            '  FORTRAN_NEXT(%s, %s);' % (name, pmpi_name)]
+    for comm in comms:
+        body.append('  MPI_Fint correct_%s = GetCorrectFortranComm(*%s);' % (comm, comm))
+    body += ['',
+             '  if(__builtin_expect(split_instrument, 0)) {',
+             '    const double start = Now();',
+             wrap_call('next_%s(' % name, args, ');', '    '),
+             wrap_call('InstrumentCall(', ['ROUTINE_%s' % prototype.name, 'start'] + list(message),
+                       ');', '    '),
+             '    return;',
+             '  }',
+             wrap_call('next_%s(' % name, args, ');', '  ')]
+
+    declaration = wrap_call('extern void %s(' % pmpi_name, params,
+                            ') __attribute__((weak));')
+    next_pointer = 'static __typeof__(%s) *next_%s = %s;' % (pmpi_name, name, pmpi_name)
+    signature = wrap_call('void %s(' % name, params, ') {')
+    lines = [declaration, next_pointer, signature] + body + ['}']
+    for alias in aliases:
+        lines.append('extern __typeof__(%s) %s __attribute__((alias("%s")));'
+                     % (name, alias, name))
+    return '\n'.join(lines + [''])
+
+
+def fortran_names(prototype):
+    """Return the (name, pmpi_name, hidden_lengths) Fortran entry points of
+    prototype, with _f08ts procedures being bind(C) and taking character
+    descriptors instead of hidden lengths."""
+    lower = prototype.name.lower()
+    names = [(lower + '_', 'p' + lower + '_', True)]
+    suffixes = ['_f08']
+    if prototype.has_choice_buffer():
+        suffixes.append('_f08ts')
+    for suffix in suffixes:
+        names.append((lower + suffix + '_', 'p' + lower + suffix + '_', suffix == '_f08'))
+        names.append((prototype.name + suffix, prototype.pmpi_name() + suffix,
+                      suffix == '_f08'))
+    return names
+
+
+def fortran_wrappers(prototype):
+    """Return the C source of every Fortran entry point of prototype."""
+    lower = prototype.name.lower()
+    wrappers = []
+    for name, pmpi_name, hidden_lengths in fortran_names(prototype):
+        aliases = [lower, lower + '__'] if name == lower + '_' else []
+        wrappers.append(fortran_wrapper(prototype, name, pmpi_name, hidden_lengths, aliases))
+    return '\n'.join(wrappers)
+
+
+def generate(lines, source, fortran=False):
+    out = []
+    chain = []
+    routines = []
+    names = []
+    kinds = []
+    for line in lines:
+        line = line.strip()
+        if not line or line.startswith('//'):
+            continue
+        if line.startswith('#'):
+            out.append(line)
+            chain.append(line)
+            routines.append(line)
+            names.append(line)
+            kinds.append(line)
+            continue
+        prototype = Prototype(line)
+        routines.append('  ROUTINE_%s,' % prototype.name)
+        names.append('  "%s",' % prototype.name)
+        kinds.append('  %s,' % prototype.kind())
+        if not prototype.comm_args():
+            raise ValueError("%s takes no MPI_Comm" % prototype.name)
+        if not fortran:
+            out.append(wrapper(prototype))
+            chain.append('  CHAIN_NEXT(%s);' % prototype.name)
+        elif prototype.has_fortran_binding():
+            out.append(fortran_wrappers(prototype))
+            chain += ['  CHAIN_NEXT(%s);' % name for name, _, _ in fortran_names(prototype)]
+    function = 'ChainNextFortranMPI' if fortran else 'ChainNextMPI'
+    out.append(CHAIN.format(function=function, body='\n'.join(chain)))
+    if not fortran:
+        out.append(NAMES.format(names='\n'.join(names), kinds='\n'.join(kinds)))
+    header = HEADER.format(source=source, routines='\n'.join(routines))
+    if fortran:
+        header += '\n' + FORTRAN_NEXT
+    return '\n'.join([header] + out)
+
+
+def main(argv):
+    fortran = '--fortran' in argv
+    argv = [a for a in argv if a != '--fortran']
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 1
+    with open(argv[1]) as source:
+        text = generate(source, argv[1].split('/')[-1], fortran)
+    with open(argv[2], 'w') as output:
+        output.write(text)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
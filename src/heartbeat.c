@@ -0,0 +1,136 @@
+/*
+  W_HEARTBEAT starts a background thread on rank 0 of each color that every
+  W_HEARTBEAT seconds writes a one line status record to
+  <out_err_filename>.status, beside the color's stdout/stderr: the time, the
+  number of MPI calls the rank made since the last beat and its resident memory.
+  A job monitor can spot hung tasks from records that stop changing without
+  any MPI involvement.
+
+  Records are written to a temporary file renamed over the status file, so
+  readers always see a complete record. The thread writes a final record from
+  MPI_Finalize and exits.
+*/
+
+#define _GNU_SOURCE // asprintf
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+static char *status_file = NULL;
+static double heartbeat_interval = 0.0;
+static uint64_t heartbeat_calls = 0;
+
+static pthread_t heartbeat_thread;
+static pthread_mutex_t heartbeat_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t heartbeat_stop = PTHREAD_COND_INITIALIZER;
+static int heartbeat_stopping = 0;
+
+void HeartbeatCall() {
+  __atomic_fetch_add(&heartbeat_calls, 1, __ATOMIC_RELAXED);
+}
+
+// Resident memory in kB, from /proc/self/statm
+static long ResidentKB() {
+  long pages = 0, resident = 0;
+  FILE *const file = fopen("/proc/self/statm", "r");
+  if(file) {
+    if(fscanf(file, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    fclose(file);
+  }
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void WriteHeartbeat(const uint64_t beat, const char *const state) {
+  char temp_file[4096];
+  snprintf(temp_file, sizeof(temp_file), "%s.tmp", status_file);
+  FILE *const file = fopen(temp_file, "w");
+  if(!file) {
+    fprintf(stderr, "ERROR OPENING STATUS FILE %s: %s\n", temp_file, strerror(errno));
+    return;
+  }
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  const uint64_t calls = __atomic_exchange_n(&heartbeat_calls, 0, __ATOMIC_RELAXED);
+  fprintf(file, "time=%.3f beat=%llu state=%s calls=%llu rss_kb=%ld\n",
+          now.tv_sec + 1.0e-6*now.tv_usec, (unsigned long long)beat, state,
+          (unsigned long long)calls, ResidentKB());
+  fclose(file);
+
+  if(rename(temp_file, status_file))
+    fprintf(stderr, "ERROR RENAMING STATUS FILE %s: %s\n", status_file, strerror(errno));
+}
+
+static void *Heartbeat(void *arg) {
+  uint64_t beat = 0;
+  pthread_mutex_lock(&heartbeat_mutex);
+  while(!heartbeat_stopping) {
+    WriteHeartbeat(beat++, "running");
+
+    struct timespec wake;
+    clock_gettime(CLOCK_REALTIME, &wake);
+    const double next = wake.tv_sec + 1.0e-9*wake.tv_nsec + heartbeat_interval;
+    wake.tv_sec = (time_t)next;
+    wake.tv_nsec = (long)((next - wake.tv_sec) * 1.0e9);
+    int err = 0;
+    while(!heartbeat_stopping && err != ETIMEDOUT)
+      err = pthread_cond_timedwait(&heartbeat_stop, &heartbeat_mutex, &wake);
+  }
+  pthread_mutex_unlock(&heartbeat_mutex);
+
+  WriteHeartbeat(beat, "finalized");
+  return NULL;
+}
+
+void HeartbeatInit(const char *const out_err_filename, const int color_rank) {
+  const char *const interval = getenv("W_HEARTBEAT");
+  if(!interval || color_rank != 0)
+    return;
+
+  heartbeat_interval = atof(interval);
+  if(heartbeat_interval <= 0.0)
+    EXIT_PRINT("W_HEARTBEAT must be a positive number of seconds\n");
+
+  // The application may change directory before the thread next writes
+  char cwd[2048];
+  int length;
+  if(out_err_filename[0] == '/')
+    length = asprintf(&status_file, "%s.status", out_err_filename);
+  else if(getcwd(cwd, sizeof(cwd)))
+    length = asprintf(&status_file, "%s/%s.status", cwd, out_err_filename);
+  else
+    EXIT_PRINT("Error getting working directory: %s\n", strerror(errno));
+  if(length < 0)
+    EXIT_PRINT("Error allocating status file name!\n");
+
+  split_instrument |= INSTRUMENT_HEARTBEAT;
+
+  const int err = pthread_create(&heartbeat_thread, NULL, Heartbeat, NULL);
+  if(err) {
+    fprintf(stderr, "ERROR STARTING HEARTBEAT THREAD: %s\n", strerror(err));
+    split_instrument &= ~INSTRUMENT_HEARTBEAT;
+  }
+}
+
+void StopHeartbeat() {
+  if(!(split_instrument & INSTRUMENT_HEARTBEAT))
+    return;
+
+  pthread_mutex_lock(&heartbeat_mutex);
+  heartbeat_stopping = 1;
+  pthread_cond_signal(&heartbeat_stop);
+  pthread_mutex_unlock(&heartbeat_mutex);
+
+  pthread_join(heartbeat_thread, NULL);
+  split_instrument &= ~INSTRUMENT_HEARTBEAT;
+}
@@ -0,0 +1,274 @@
+/*
+  W_PROFILE counts the calls, message bytes and time spent in each wrapped MPI
+  routine. Counters are kept per thread so the wrappers never contend, and are
+  summed and reduced over the rank's color at MPI_Finalize. Color rank 0 writes
+  the report to <out_err_filename>.prof, beside the color's stdout/stderr.
+
+  Message bytes are the count and datatype a call was given, e.g. the receive
+  buffer size of MPI_Recv or the per rank contribution of MPI_Allreduce, and
+  routines without a single count and datatype count no bytes. The message
+  sizes of point to point and collective calls are also counted in log2
+  histograms, reported with the routines.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+int split_instrument = 0;
+
+typedef struct {
+  uint64_t calls;
+  uint64_t bytes;
+  double time;
+} RoutineCounters;
+
+// Bucket 0 counts empty messages and bucket b messages of 2^(b-1) to 2^b - 1 bytes
+#define HISTOGRAM_BUCKETS 65
+
+// Counters of one thread, threads are chained on profile_threads when they
+// first make an MPI call
+typedef struct ThreadCounters {
+  struct ThreadCounters *next;
+  uint64_t histograms[2][HISTOGRAM_BUCKETS];
+  RoutineCounters routines[];
+} ThreadCounters;
+
+static __thread ThreadCounters *thread_counters = NULL;
+static ThreadCounters *profile_threads = NULL;
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char profile_file[2048];
+static double profile_start = 0.0;
+static double profile_end = 0.0;
+
+static ThreadCounters *GetThreadCounters() {
+  if(!thread_counters) {
+    thread_counters = calloc(1, sizeof(ThreadCounters) +
+                                split_routine_count * sizeof(RoutineCounters));
+    if(!thread_counters)
+      EXIT_PRINT("Error allocating profile memory!\n");
+
+    pthread_mutex_lock(&profile_mutex);
+    thread_counters->next = profile_threads;
+    profile_threads = thread_counters;
+    pthread_mutex_unlock(&profile_mutex);
+  }
+
+  return thread_counters;
+}
+
+// Sizes of the predefined datatypes used by this thread, hashed by handle
+// Derived datatypes may be freed and their handle reused so aren't cached
+#define TYPE_CACHE_SIZE 64
+typedef struct {
+  MPI_Datatype datatype;
+  int size;
+  int cached;
+} TypeSize;
+static __thread TypeSize type_cache[TYPE_CACHE_SIZE];
+
+static int DatatypeSize(const MPI_Datatype datatype) {
+  const uintptr_t handle = (uintptr_t)datatype;
+  TypeSize *const entry = &type_cache[(handle ^ handle >> 6) % TYPE_CACHE_SIZE];
+  if(entry->cached && entry->datatype == datatype)
+    return entry->size;
+
+  int size;
+  if(PMPI_Type_size(datatype, &size) != MPI_SUCCESS || size < 0)
+    return 0;
+
+  int integers, addresses, datatypes, combiner;
+  PMPI_Type_get_envelope(datatype, &integers, &addresses, &datatypes, &combiner);
+  if(combiner == MPI_COMBINER_NAMED) {
+    entry->datatype = datatype;
+    entry->size = size;
+    entry->cached = 1;
+  }
+
+  return size;
+}
+
+static uint64_t MessageBytes(const MPI_Count count, const MPI_Datatype datatype) {
+  if(count <= 0 || datatype == MPI_DATATYPE_NULL)
+    return 0;
+
+  return (uint64_t)count * DatatypeSize(datatype);
+}
+
+static int HistogramBucket(const uint64_t bytes) {
+  return bytes ? 64 - __builtin_clzll(bytes) : 0;
+}
+
+void InstrumentCall(const int routine, const double start, const MPI_Count count,
+                    const MPI_Datatype datatype) {
+  const double end = Now();
+  const uint64_t bytes = MessageBytes(count, datatype);
+
+  if(split_instrument & INSTRUMENT_PROFILE) {
+    RoutineCounters *const counters = &GetThreadCounters()->routines[routine];
+    counters->calls++;
+    counters->bytes += bytes;
+    counters->time += end - start;
+
+    const int kind = split_routine_kinds[routine];
+    if(kind != ROUTINE_OTHER)
+      GetThreadCounters()->histograms[kind == ROUTINE_COLLECTIVE][HistogramBucket(bytes)]++;
+  }
+
+  if(split_instrument & INSTRUMENT_TRACE)
+    TraceCall(routine, start, end, bytes);
+
+  if(split_instrument & INSTRUMENT_HEARTBEAT)
+    HeartbeatCall();
+}
+
+void ProfileInit(const char *const out_err_filename) {
+  if(!getenv("W_PROFILE"))
+    return;
+
+  snprintf(profile_file, sizeof(profile_file), "%s.prof", out_err_filename);
+  profile_start = Now();
+  split_instrument |= INSTRUMENT_PROFILE;
+}
+
+// The rank's elapsed time ends on entry to MPI_Finalize, before the reports'
+// collectives wait on other colors
+void ProfileStop() {
+  if(split_instrument & INSTRUMENT_PROFILE)
+    profile_end = Now();
+}
+
+// Sort routines by descending total time
+static const double *sort_times;
+static int CompareRoutineTimes(const void *a, const void *b) {
+  const double x = sort_times[*(const int*)a];
+  const double y = sort_times[*(const int*)b];
+  return (x < y) - (x > y);
+}
+
+// Write the rows of the point to point and collective histograms from the
+// smallest to the largest non empty bucket
+static void WriteHistograms(FILE *const file,
+                            const uint64_t (*const histograms)[HISTOGRAM_BUCKETS]) {
+  int first = HISTOGRAM_BUCKETS;
+  int last = -1;
+  int bucket;
+  for(bucket=0; bucket<HISTOGRAM_BUCKETS; bucket++) {
+    if(histograms[0][bucket] || histograms[1][bucket]) {
+      if(first == HISTOGRAM_BUCKETS)
+        first = bucket;
+      last = bucket;
+    }
+  }
+  if(last < 0)
+    return;
+
+  fprintf(file, "\n%-32s %14s %14s\n", "message size (bytes)", "p2p", "collective");
+  for(bucket=first; bucket<=last; bucket++) {
+    char range[64];
+    if(bucket == 0)
+      snprintf(range, sizeof(range), "0");
+    else
+      snprintf(range, sizeof(range), "%llu-%llu", 1ULL << (bucket - 1),
+               bucket == 64 ? ~0ULL : (1ULL << bucket) - 1);
+    fprintf(file, "%-32s %14llu %14llu\n", range, (unsigned long long)histograms[0][bucket],
+            (unsigned long long)histograms[1][bucket]);
+  }
+}
+
+// Sum the thread counters and reduce them over comm, rank 0 of comm writes
+// the routines called sorted by total time and the message size histograms
+void ReportProfile(const MPI_Comm comm) {
+  if(!(split_instrument & INSTRUMENT_PROFILE))
+    return;
+  split_instrument &= ~INSTRUMENT_PROFILE;
+
+  const int count = split_routine_count;
+  uint64_t *const counts = calloc(4 * count, sizeof(uint64_t));
+  double *const times = calloc(3 * count, sizeof(double));
+  int *const order = malloc(count * sizeof(int));
+  uint64_t (*const histograms)[HISTOGRAM_BUCKETS] = calloc(4, sizeof(*histograms));
+  if(!counts || !times || !order || !histograms)
+    EXIT_PRINT("Error allocating profile memory!\n");
+
+  // counts holds the rank's calls and bytes per routine then their sums over
+  // comm, times holds the rank's time per routine then its sum and max, and
+  // histograms the rank's point to point and collective histograms then their sums
+  uint64_t *const sum_counts = counts + 2 * count;
+  double *const sum_times = times + count;
+  double *const max_times = times + 2 * count;
+  double elapsed[2] = {(profile_end > 0.0 ? profile_end : Now()) - profile_start, 0.0};
+  double max_elapsed;
+
+  pthread_mutex_lock(&profile_mutex);
+  const ThreadCounters *thread;
+  int i;
+  for(thread=profile_threads; thread; thread=thread->next) {
+    for(i=0; i<count; i++) {
+      counts[i] += thread->routines[i].calls;
+      counts[count + i] += thread->routines[i].bytes;
+      times[i] += thread->routines[i].time;
+    }
+    for(i=0; i<HISTOGRAM_BUCKETS; i++) {
+      histograms[0][i] += thread->histograms[0][i];
+      histograms[1][i] += thread->histograms[1][i];
+    }
+  }
+  pthread_mutex_unlock(&profile_mutex);
+
+  int rank, size;
+  PMPI_Comm_rank(comm, &rank);
+  PMPI_Comm_size(comm, &size);
+  PMPI_Reduce(counts, sum_counts, 2 * count, MPI_UINT64_T, MPI_SUM, 0, comm);
+  PMPI_Reduce(times, sum_times, count, MPI_DOUBLE, MPI_SUM, 0, comm);
+  PMPI_Reduce(times, max_times, count, MPI_DOUBLE, MPI_MAX, 0, comm);
+  PMPI_Reduce(&elapsed[0], &elapsed[1], 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+  PMPI_Reduce(&elapsed[0], &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  PMPI_Reduce(histograms, histograms + 2, 2 * HISTOGRAM_BUCKETS, MPI_UINT64_T, MPI_SUM, 0, comm);
+
+  if(rank == 0) {
+    FILE *const file = fopen(profile_file, "w");
+    if(file) {
+      double mpi_time = 0.0;
+      int called = 0;
+      for(i=0; i<count; i++) {
+        mpi_time += sum_times[i];
+        if(sum_counts[i])
+          order[called++] = i;
+      }
+      sort_times = sum_times;
+      qsort(order, called, sizeof(int), CompareRoutineTimes);
+
+      fprintf(file, "# wraprun profile over %d ranks\n", size);
+      fprintf(file, "# elapsed (s) avg %.6f max %.6f, MPI time (s) avg %.6f (%.1f%%)\n",
+              elapsed[1]/size, max_elapsed, mpi_time/size,
+              elapsed[1] > 0.0 ? 100.0*mpi_time/elapsed[1] : 0.0);
+      fprintf(file, "%-32s %14s %18s %14s %14s %8s\n", "routine", "calls", "bytes",
+              "total (s)", "max rank (s)", "% MPI");
+      for(i=0; i<called; i++) {
+        const int routine = order[i];
+        fprintf(file, "%-32s %14llu %18llu %14.6f %14.6f %7.1f%%\n", split_routine_names[routine],
+                (unsigned long long)sum_counts[routine],
+                (unsigned long long)sum_counts[count + routine], sum_times[routine],
+                max_times[routine], mpi_time > 0.0 ? 100.0*sum_times[routine]/mpi_time : 0.0);
+      }
+      WriteHistograms(file, histograms + 2);
+
+      fclose(file);
+    }
+    else
+      fprintf(stderr, "ERROR OPENING PROFILE FILE %s: %s\n", profile_file, strerror(errno));
+  }
+
+  free(histograms);
+  free(order);
+  free(times);
+  free(counts);
+}
@@ -24,14 +24,19 @@ THE SOFTWARE.
 
 /*
   libsplit is a library designed to split MPI_COMM_WORLD into multiple smaller
-  communicators. Upon calling MPI_Init() the file pointed to by the WRAPRUN_FILE
-  environment variable is opened and the contents read. This file content is parsed
+  communicators. Upon calling MPI_Init() the layout held in the WRAPRUN_LAYOUT
+  environment variable, or else the file pointed to by the WRAPRUN_FILE
+  environment variable, is read. This content is parsed
   to determine the ranks particular color as well as the desired working directory
   and process specific environment variables.
 
   The color is used to create the MPI_COMM_SPLIT communicator. All MPI* functions
   containing a communicator are provided and anytime MPI_COMM_WORLD is passed
   in it will be switched out for MPI_COMM_SPLIT before calling PMPI*
+
+  Those wrappers are generated at build time by gen_wrappers.py from the
+  prototypes listed in mpi_prototypes.txt, this file holds the setup done in
+  MPI_Init and the teardown done in MPI_Finalize
 */
 
 #define _GNU_SOURCE // RTLD_NEXT, must define this before ANY standard header
@@ -43,56 +48,503 @@ THE SOFTWARE.
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
-#include "print_macros.h"
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
 
-static MPI_Comm MPI_COMM_SPLIT = MPI_COMM_NULL;
+MPI_Comm MPI_COMM_SPLIT = MPI_COMM_NULL;
 
-// Reads in rank line of WRAPRUN_FILE
-// space seperated values are parsed to set color, work_dir, and env_vars
-static void GetRankParamsFromFile(const int rank, int *color, char *work_dir,
-                                  char *out_err_filename, char *env_vars) {
-  // Get file name from environment variable
-  const char *const file_name = getenv("WRAPRUN_FILE");
-  if(!file_name)
-    EXIT_PRINT("%s environment variable not set, exiting!\n", "WRAPRUN_FILE");
+// W_LAZY_SPLIT defers creating MPI_COMM_SPLIT for single rank colors until
+// MPI_COMM_WORLD is first translated, ranks that never communicate skip it
+int split_deferred = 0;
+static int split_first_rank = 0;
+static pthread_once_t split_once = PTHREAD_ONCE_INIT;
+
+// Set once SplitInit() has run, the Fortran MPI_Init may or may not go
+// through the C MPI_Init
+static int split_initialized = 0;
 
-  // Search file and read in rank'th line of file
-  FILE *const file = fopen(file_name, "r");
-  if(!file)
-    EXIT_PRINT("Can't open %s\n", file_name);
+MPI_Fint fortran_comm_world = 0;
+MPI_Fint fortran_comm_split = 0;
 
-  char *line = NULL;
+// Startup phases timed in MPI_Init and SplitInit, reported to W_TIMING_FILE
+enum { PHASE_INIT, PHASE_READ, PHASE_SPLIT, PHASE_CHDIR, PHASE_STDIO, PHASE_ENV, PHASE_COUNT };
+static const char *const PHASE_NAMES[PHASE_COUNT] = {"init", "read", "split", "chdir", "stdio", "env"};
+static double phase_times[PHASE_COUNT];
 
-  int line_num;
-  for(line_num=0; line_num<=rank; ++line_num) {
-    size_t length = 0;
-    const ssize_t char_count = getline(&line, &length, file);
-    if(char_count == -1)
-      EXIT_PRINT("Error reading rank %d info from %s\n", rank, file_name);
+// Sizes of the per rank parameter buffers filled from WRAPRUN_FILE
+#define WORK_DIR_SIZE 2048
+#define OUT_ERR_SIZE 2048
+#define ENV_VARS_SIZE 4096
+
+// Runtime parameters of a single rank
+// first_rank and rank_count give the world ranks sharing the color, a rank_count
+// of 0 means the range isn't known
+typedef struct {
+  int color;
+  int first_rank;
+  int rank_count;
+  char work_dir[WORK_DIR_SIZE];
+  char out_err_filename[OUT_ERR_SIZE];
+  char env_vars[ENV_VARS_SIZE];
+} RankParams;
+
+// Contents of WRAPRUN_FILE, either indexed records or text split into lines
+// Indexed records are mapped from the file or decoded from WRAPRUN_LAYOUT
+typedef struct {
+  const char *file_name;
+  char *data;
+  size_t size;
+  int indexed;
+  int mapped;
+  char **lines;
+  size_t line_count;
+} ParamFile;
+
+// Indexed binary WRAPRUN_FILE layout written by the python frontend, all
+// integers little endian:
+//   header  : char magic[8], uint32 version, uint32 rank count,
+//             uint32 range count, uint32 padding
+//   ranges  : uint32 first rank, uint32 rank count, uint64 record offset
+//             for each task split, sorted by first rank
+//   records : int32 color, uint32 work_dir, out_err and env_vars lengths
+//             followed by the three NUL terminated strings
+// Files without the magic are parsed as one "color work_dir out_err env" line per rank
+static const char INDEX_MAGIC[8] = "WRAPRUN";
+#define INDEX_VERSION 2
+#define INDEX_HEADER_SIZE 24
+#define INDEX_RANGE_SIZE 16
+#define INDEX_RECORD_SIZE 16
+
+static uint32_t ReadU32(const char *const data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return le32toh(value);
+}
+
+static uint64_t ReadU64(const char *const data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return le64toh(value);
+}
+
+// Copy a length prefixed record string, checking it fits in both the mapped file and dest
+static const char *CopyRecordString(const char *src, const uint32_t length,
+                                    const char *const end, char *dest, const size_t dest_size) {
+  if(length >= dest_size || (size_t)(end - src) <= length || src[length] != '\0')
+    EXIT_PRINT("Malformed record in WRAPRUN_FILE\n");
+  memcpy(dest, src, length + 1);
+  return src + length + 1;
+}
+
+// Look up rank's record in an indexed WRAPRUN_FILE held in memory
+// The range table is binary searched for the task split containing rank
+static void GetRankParamsFromIndex(const char *const data, const size_t size, const int rank,
+                                   RankParams *params) {
+  if(size < INDEX_HEADER_SIZE || ReadU32(data + 8) != INDEX_VERSION)
+    EXIT_PRINT("Unsupported WRAPRUN_FILE format version\n");
+
+  const uint32_t rank_count = ReadU32(data + 12);
+  const uint32_t range_count = ReadU32(data + 16);
+  if(rank < 0 || (uint32_t)rank >= rank_count)
+    EXIT_PRINT("Rank %d not found in WRAPRUN_FILE of %u ranks\n", rank, rank_count);
+
+  if((size - INDEX_HEADER_SIZE) / INDEX_RANGE_SIZE < range_count)
+    EXIT_PRINT("Truncated WRAPRUN_FILE range table\n");
+
+  // Find the last range starting at or before rank
+  const char *const ranges = data + INDEX_HEADER_SIZE;
+  uint32_t low = 0;
+  uint32_t high = range_count;
+  while(low < high) {
+    const uint32_t mid = low + (high - low)/2;
+    if(ReadU32(ranges + (size_t)mid*INDEX_RANGE_SIZE) <= (uint32_t)rank)
+      low = mid + 1;
+    else
+      high = mid;
   }
 
+  if(low == 0)
+    EXIT_PRINT("Rank %d not found in WRAPRUN_FILE ranges\n", rank);
+
+  const char *const range = ranges + (size_t)(low - 1)*INDEX_RANGE_SIZE;
+  if((uint32_t)rank - ReadU32(range) >= ReadU32(range + 4))
+    EXIT_PRINT("Rank %d not found in WRAPRUN_FILE ranges\n", rank);
+  params->first_rank = (int)ReadU32(range);
+  params->rank_count = (int)ReadU32(range + 4);
+
+  const uint64_t offset = ReadU64(range + 8);
+  if(offset > size || size - offset < INDEX_RECORD_SIZE)
+    EXIT_PRINT("Truncated WRAPRUN_FILE record for rank %d\n", rank);
+
+  const char *record = data + offset;
+  const char *const end = data + size;
+  params->color = (int)ReadU32(record);
+  const uint32_t work_dir_length = ReadU32(record + 4);
+  const uint32_t out_err_length = ReadU32(record + 8);
+  const uint32_t env_vars_length = ReadU32(record + 12);
+
+  record += INDEX_RECORD_SIZE;
+  record = CopyRecordString(record, work_dir_length, end, params->work_dir, WORK_DIR_SIZE);
+  record = CopyRecordString(record, out_err_length, end, params->out_err_filename, OUT_ERR_SIZE);
+  CopyRecordString(record, env_vars_length, end, params->env_vars, ENV_VARS_SIZE);
+}
+
+// Reads in rank line of a text WRAPRUN_FILE
+// space seperated values are parsed to set color, work_dir, and env_vars
+static void GetRankParamsFromText(const ParamFile *const file, const int rank,
+                                  RankParams *params) {
+  if(rank < 0 || (size_t)rank >= file->line_count)
+    EXIT_PRINT("Error reading rank %d info from %s\n", rank, file->file_name);
+
   // Extract parameters
-  const int num_params = sscanf(line, "%d %s %s %s", color, work_dir, out_err_filename, env_vars);
+  const int num_params = sscanf(file->lines[rank], "%d %2047s %2047s %4095s", &params->color,
+                                params->work_dir, params->out_err_filename, params->env_vars);
   if(num_params == EOF)
     EXIT_PRINT("Error parsing file line\n");
+}
+
+// Decode a base64 string in place, returning the decoded length
+static size_t DecodeBase64(char *const text) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t length = 0;
+  uint32_t bits = 0;
+  int bit_count = 0;
+  const char *c;
+  for(c=text; *c && *c != '='; c++) {
+    const char *const digit = strchr(alphabet, *c);
+    if(!digit)
+      EXIT_PRINT("Invalid character in WRAPRUN_LAYOUT\n");
+    bits = (bits << 6) | (uint32_t)(digit - alphabet);
+    bit_count += 6;
+    if(bit_count >= 8) {
+      bit_count -= 8;
+      text[length++] = (char)(bits >> bit_count);
+    }
+  }
+  return length;
+}
+
+// WRAPRUN_LAYOUT holds the indexed layout for small bundles so no file need be read
+// Format is base64 of the uint32 layout length followed by the zlib compressed layout
+static void DecodeLayout(ParamFile *file, const char *const encoded) {
+  file->file_name = "WRAPRUN_LAYOUT";
+
+  char *const compressed = strdup(encoded);
+  if(!compressed)
+    EXIT_PRINT("Error allocating WRAPRUN_LAYOUT memory!\n");
+  const size_t compressed_size = DecodeBase64(compressed);
+  if(compressed_size < sizeof(uint32_t))
+    EXIT_PRINT("Truncated WRAPRUN_LAYOUT\n");
+
+  uLongf size = ReadU32(compressed);
+  file->data = malloc(size ? size : 1);
+  if(!file->data)
+    EXIT_PRINT("Error allocating WRAPRUN_LAYOUT memory!\n");
+
+  const int err = uncompress((Bytef*)file->data, &size, (const Bytef*)compressed + sizeof(uint32_t),
+                             compressed_size - sizeof(uint32_t));
+  if(err != Z_OK)
+    EXIT_PRINT("Error decompressing WRAPRUN_LAYOUT: %d\n", err);
+
+  file->size = size;
+  file->indexed = file->size >= sizeof(INDEX_MAGIC) &&
+                  memcmp(file->data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0;
+  if(!file->indexed)
+    EXIT_PRINT("WRAPRUN_LAYOUT is not an indexed layout\n");
+
+  free(compressed);
+}
+
+// Open WRAPRUN_LAYOUT or WRAPRUN_FILE
+// Indexed files are mapped and text files are read and split into lines
+static void OpenParamFile(ParamFile *file) {
+  memset(file, 0, sizeof(ParamFile));
+
+  const char *const layout = getenv("WRAPRUN_LAYOUT");
+  if(layout) {
+    DecodeLayout(file, layout);
+    return;
+  }
+
+  // Get file name from environment variable
+  file->file_name = getenv("WRAPRUN_FILE");
+  if(!file->file_name)
+    EXIT_PRINT("%s environment variable not set, exiting!\n", "WRAPRUN_FILE");
+
+  const int fd = open(file->file_name, O_RDONLY);
+  if(fd == -1)
+    EXIT_PRINT("Can't open %s\n", file->file_name);
+
+  struct stat file_stat;
+  if(fstat(fd, &file_stat))
+    EXIT_PRINT("Can't stat %s: %s\n", file->file_name, strerror(errno));
+  file->size = file_stat.st_size;
+
+  char magic[sizeof(INDEX_MAGIC)];
+  const ssize_t magic_size = pread(fd, magic, sizeof(magic), 0);
+  file->indexed = magic_size == sizeof(magic) && memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0;
+
+  if(file->indexed) {
+    file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(file->data == MAP_FAILED)
+      EXIT_PRINT("Can't map %s: %s\n", file->file_name, strerror(errno));
+    file->mapped = 1;
+  }
+  else {
+    file->data = malloc(file->size + 1);
+    if(!file->data)
+      EXIT_PRINT("Error allocating %s memory!\n", file->file_name);
+
+    size_t total = 0;
+    while(total < file->size) {
+      const ssize_t count = pread(fd, file->data + total, file->size - total, total);
+      if(count <= 0)
+        EXIT_PRINT("Error reading %s: %s\n", file->file_name, strerror(errno));
+      total += count;
+    }
+    file->data[file->size] = '\0';
+
+    // Split into lines in place
+    size_t capacity = 0;
+    char *line = file->data;
+    while(line < file->data + file->size) {
+      if(file->line_count == capacity) {
+        capacity = capacity ? 2*capacity : 1024;
+        file->lines = realloc(file->lines, capacity * sizeof(char*));
+        if(!file->lines)
+          EXIT_PRINT("Error allocating %s line memory!\n", file->file_name);
+      }
+      file->lines[file->line_count++] = line;
+
+      char *const newline = strchr(line, '\n');
+      if(!newline)
+        break;
+      *newline = '\0';
+      line = newline + 1;
+    }
+  }
+
+  close(fd);
+}
+
+static void CloseParamFile(ParamFile *file) {
+  if(file->mapped)
+    munmap(file->data, file->size);
+  else
+    free(file->data);
+  free(file->lines);
+  memset(file, 0, sizeof(ParamFile));
+}
+
+static void GetRankParams(const ParamFile *const file, const int rank, RankParams *params) {
+  memset(params, 0, sizeof(RankParams));
+  if(file->indexed)
+    GetRankParamsFromIndex(file->data, file->size, rank, params);
+  else
+    GetRankParamsFromText(file, rank, params);
+}
+
+// Reads in rank's parameters from WRAPRUN_FILE
+static void GetRankParamsFromFile(const int rank, RankParams *params) {
+  ParamFile file;
+  OpenParamFile(&file);
+  GetRankParams(&file, rank, params);
+  CloseParamFile(&file);
+}
+
+// Pack parameters as the color and rank range followed by the NUL terminated strings
+static size_t PackRankParams(const RankParams *const params, char *buffer) {
+  char *position = buffer;
+  const int values[] = {params->color, params->first_rank, params->rank_count};
+  memcpy(position, values, sizeof(values));
+  position += sizeof(values);
+
+  const char *const strings[] = {params->work_dir, params->out_err_filename, params->env_vars};
+  int i;
+  for(i=0; i<3; i++) {
+    const size_t length = strlen(strings[i]) + 1;
+    memcpy(position, strings[i], length);
+    position += length;
+  }
+
+  return position - buffer;
+}
+
+static void UnpackRankParams(const char *buffer, const int size, RankParams *params) {
+  memset(params, 0, sizeof(RankParams));
+  int values[3];
+  if(size < (int)sizeof(values) + 3 || buffer[size-1] != '\0')
+    EXIT_PRINT("Malformed scattered rank parameters\n");
+
+  memcpy(values, buffer, sizeof(values));
+  params->color = values[0];
+  params->first_rank = values[1];
+  params->rank_count = values[2];
+  buffer += sizeof(values);
+  snprintf(params->work_dir, WORK_DIR_SIZE, "%s", buffer);
+  buffer += strlen(buffer) + 1;
+  snprintf(params->out_err_filename, OUT_ERR_SIZE, "%s", buffer);
+  buffer += strlen(buffer) + 1;
+  snprintf(params->env_vars, ENV_VARS_SIZE, "%s", buffer);
+}
+
+// World rank 0 reads WRAPRUN_FILE once and scatters each rank its parameters
+// Limits file system traffic at startup to a single open
+static void ScatterRankParams(const int entry, RankParams *params) {
+  int world_rank, world_size;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  PMPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  // Ranks may look up a WRAPRUN_FILE entry other than their world rank
+  int *entries = NULL;
+  int *counts = NULL;
+  int *displs = NULL;
+  char *send_buffer = NULL;
+  if(world_rank == 0) {
+    entries = malloc(world_size * sizeof(int));
+    counts = malloc(world_size * sizeof(int));
+    displs = malloc(world_size * sizeof(int));
+    if(!entries || !counts || !displs)
+      EXIT_PRINT("Error allocating scatter memory!\n");
+  }
+
+  int err = PMPI_Gather(&entry, 1, MPI_INT, entries, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to gather rank parameter entries: %d!\n", err);
+
+  if(world_rank == 0) {
+    ParamFile file;
+    OpenParamFile(&file);
+
+    RankParams *const entry_params = malloc(sizeof(RankParams));
+    if(!entry_params)
+      EXIT_PRINT("Error allocating scatter memory!\n");
+
+    size_t capacity = 0;
+    size_t total = 0;
+    int i;
+    for(i=0; i<world_size; i++) {
+      GetRankParams(&file, entries[i], entry_params);
+
+      if(total + sizeof(RankParams) > capacity) {
+        capacity = 2*(total + sizeof(RankParams));
+        send_buffer = realloc(send_buffer, capacity);
+        if(!send_buffer)
+          EXIT_PRINT("Error allocating scatter memory!\n");
+      }
+
+      const size_t count = PackRankParams(entry_params, send_buffer + total);
+      if(total + count > INT_MAX)
+        EXIT_PRINT("Scattered rank parameters exceed %d bytes\n", INT_MAX);
+      counts[i] = count;
+      displs[i] = total;
+      total += count;
+    }
+
+    free(entry_params);
+    CloseParamFile(&file);
+  }
+
+  int recv_count;
+  err = PMPI_Scatter(counts, 1, MPI_INT, &recv_count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to scatter rank parameter sizes: %d!\n", err);
 
+  char *const recv_buffer = malloc(recv_count);
+  if(!recv_buffer)
+    EXIT_PRINT("Error allocating scatter memory!\n");
+
+  err = PMPI_Scatterv(send_buffer, counts, displs, MPI_CHAR,
+                      recv_buffer, recv_count, MPI_CHAR, 0, MPI_COMM_WORLD);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to scatter rank parameters: %d!\n", err);
+
+  UnpackRankParams(recv_buffer, recv_count, params);
+
+  free(recv_buffer);
+  free(send_buffer);
+  free(displs);
+  free(counts);
+  free(entries);
+}
+
+// Optionally suffix the stdout/stderr basename with the ALPS application id
+static void AppendApidToStdio(RankParams *params) {
   if(getenv("APPEND_APID_STDIO")) {
     char *filename = NULL;
-    int length = asprintf(&filename, "%s", out_err_filename);
-    length |= sprintf(out_err_filename, "%s_%s", filename, getenv("ALPS_APP_ID"));
+    int length = asprintf(&filename, "%s", params->out_err_filename);
+    length |= snprintf(params->out_err_filename, OUT_ERR_SIZE, "%s_%s", filename, getenv("ALPS_APP_ID"));
     free(filename);
     if(length < 0) {
       EXIT_PRINT("Error appending apid to stdio files\n");
     }
   }
+}
 
-  free(line);
-  fclose(file);
+// Group of the rank_count world ranks starting at first_rank that share a color
+static void CreateColorGroup(const int first_rank, const int rank_count, MPI_Group *color_group) {
+  MPI_Group world_group;
+  int err = PMPI_Comm_group(MPI_COMM_WORLD, &world_group);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to get world group: %d!\n", err);
+
+  int range[1][3] = {{first_rank, first_rank + rank_count - 1, 1}};
+  err = PMPI_Group_range_incl(world_group, 1, range, color_group);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to create color group: %d!\n", err);
+
+  PMPI_Group_free(&world_group);
+}
+
+// Create MPI_COMM_SPLIT with MPI_Comm_create_group, which is collective only
+// over the color's ranks
+static void CreateGroupCommunicator(const int first_rank, const int rank_count) {
+  MPI_Group color_group;
+  CreateColorGroup(first_rank, rank_count, &color_group);
+  const int err = PMPI_Comm_create_group(MPI_COMM_WORLD, color_group, 0, &MPI_COMM_SPLIT);
+  PMPI_Group_free(&color_group);
+
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to create split communicator: %d!\n", err);
 }
 
-static void SetSplitCommunicator(const int color) {
-  const int err = PMPI_Comm_split(MPI_COMM_WORLD, color, 0, &MPI_COMM_SPLIT);
+static void CreateDeferredCommunicator() {
+  CreateGroupCommunicator(split_first_rank, 1);
+  fortran_comm_split = MPI_Comm_c2f(MPI_COMM_SPLIT);
+}
+
+void CreateDeferredSplit(void) {
+  pthread_once(&split_once, CreateDeferredCommunicator);
+}
+
+// W_SPLIT_GROUP creates MPI_COMM_SPLIT from the color's rank range rather
+// than the allgather over all of MPI_COMM_WORLD done by MPI_Comm_split
+// W_LAZY_SPLIT does the same, deferring creation for single rank colors as it
+// then involves no other rank
+// Both fall back to MPI_Comm_split when the rank range isn't known
+static void SetSplitCommunicator(const RankParams *const params) {
+  const int lazy = getenv("W_LAZY_SPLIT") != NULL;
+  if((lazy || getenv("W_SPLIT_GROUP")) && params->rank_count > 0) {
+    if(lazy && params->rank_count == 1) {
+      split_first_rank = params->first_rank;
+      split_deferred = 1;
+    }
+    else
+      CreateGroupCommunicator(params->first_rank, params->rank_count);
+    return;
+  }
+
+  const int err = PMPI_Comm_split(MPI_COMM_WORLD, params->color, 0, &MPI_COMM_SPLIT);
   if(err != MPI_SUCCESS)
     EXIT_PRINT("Failed to split communicator: %d!\n", err);
 }
@@ -130,12 +582,12 @@ static void SetEnvironmentVaribles(char *env_vars) {
 static void SetStdOutErr(const char *out_err_filename) {
   char filename[2048];
 
-  sprintf(filename, "%s.out", out_err_filename);
+  StreamFileName(filename, sizeof(filename), out_err_filename, "out");
   const FILE *const out_handle = freopen(filename, "a", stdout);
   if(!out_handle)
     EXIT_PRINT("Error setting stdout!\n");
 
-  sprintf(filename, "%s.err", out_err_filename);
+  StreamFileName(filename, sizeof(filename), out_err_filename, "err");
   const FILE *const err_handle = freopen(filename, "a", stderr);
   if(!err_handle)
     EXIT_PRINT("Error setting stderr\n");
@@ -193,7 +645,52 @@ static void ExitHandler() {
   _exit(EXIT_SUCCESS);
 }
 
+// The rank's rank in MPI_COMM_SPLIT, a deferred MPI_COMM_SPLIT holds only
+// this rank
+static int ColorRank() {
+  int color_rank = 0;
+  if(!split_deferred)
+    PMPI_Comm_rank(MPI_COMM_SPLIT, &color_rank);
+  return color_rank;
+}
+
+// Change to the rank's working directory, redirect stdout/stderr and set its
+// environment variables. Staging and the pumped output modes are only set up
+// for ranks of the world model, as electing W_FORWARD_OUTERR aggregators is
+// collective over MPI_COMM_WORLD and MPI_Finalize drains the pumps and stages
+// the files out
+static void SetRankEnvironment(RankParams *params, const int color_rank, const int world_model) {
+  double start = Now();
+  SetWorkingDirectory(params->work_dir);
+  phase_times[PHASE_CHDIR] = Now() - start;
+
+  start = Now();
+  if (getenv("W_REDIRECT_OUTERR")) {
+    if (world_model)
+      StageInit();
+    const int pumped = getenv("W_FORWARD_OUTERR") || getenv("W_COMPRESS_OUTERR") ||
+                       getenv("W_TAG_OUTERR") || getenv("W_LAZY_OUTERR");
+    if ((pumped || getenv("W_STAGE_OUTERR")) && !world_model && color_rank == 0)
+      fprintf(stderr, "W_FORWARD_OUTERR, W_COMPRESS_OUTERR, W_TAG_OUTERR, W_LAZY_OUTERR and "
+                      "W_STAGE_OUTERR need MPI_Init, redirecting color %d output directly\n",
+              params->color);
+    if (pumped && world_model)
+      ForwardStdOutErr(params->out_err_filename, params->color, color_rank);
+    else
+      SetStdOutErr(params->out_err_filename);
+  }
+  phase_times[PHASE_STDIO] = Now() - start;
+
+  start = Now();
+  SetEnvironmentVaribles(params->env_vars);
+  phase_times[PHASE_ENV] = Now() - start;
+}
+
 static void SplitInit() {
+  if(split_initialized)
+    return;
+  split_initialized = 1;
+
   // Cray has issues when LD_PRELOAD is set
   // and exec*() is called...this is a workaround
   if (getenv("W_UNSET_PRELOAD"))
@@ -202,24 +699,27 @@ static void SplitInit() {
   int rank;
   PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-  int color;
-  char *const work_dir = calloc(2048, sizeof(char));
-  if(!work_dir)
-    EXIT_PRINT("Error allocating work_dir memory!\n");
-  char *const out_err_filename = calloc(2048, sizeof(char));
-  if(!out_err_filename)
-    EXIT_PRINT("Error allocating out_err_filename memory!\n");
-  char *const env_vars = calloc(4096, sizeof(char));
-  if(!env_vars)
-    EXIT_PRINT("Error allocating env_vars memory!\n");
-  env_vars[0] = '\0'; // "zero" out env_vars
-
-  if(getenv("W_RANK_FROM_ENV")) {
-    int env_rank = atoi(getenv("W_ENV_RANK"));
-    GetRankParamsFromFile(env_rank, &color, work_dir, out_err_filename, env_vars);
-  }
+  RankParams *const params = calloc(1, sizeof(RankParams));
+  if(!params)
+    EXIT_PRINT("Error allocating rank parameter memory!\n");
+
+  // Entry of WRAPRUN_FILE describing this rank
+  const int entry = getenv("W_RANK_FROM_ENV") ? atoi(getenv("W_ENV_RANK")) : rank;
+
+  double start = Now();
+
+  if(getenv("W_SCATTER_PARAMS"))
+    ScatterRankParams(entry, params);
   else
-    GetRankParamsFromFile(rank, &color, work_dir, out_err_filename, env_vars);
+    GetRankParamsFromFile(entry, params);
+
+  // Ranges of entries looked up by W_ENV_RANK don't describe world ranks
+  if(getenv("W_RANK_FROM_ENV"))
+    params->rank_count = 0;
+
+  AppendApidToStdio(params);
+
+  phase_times[PHASE_READ] = Now() - start;
 
   if (getenv("W_IGNORE_SEGV")) {
     sighandler_t err_sig;
@@ -251,24 +751,94 @@ static void SplitInit() {
       fprintf(stderr, "ERROR REGISTERING ATEXIT HANDLER!\n");
   }
 
-  SetSplitCommunicator(color);
+  start = Now();
+  SetSplitCommunicator(params);
+  fortran_comm_world = MPI_Comm_c2f(MPI_COMM_WORLD);
+  fortran_comm_split = MPI_Comm_c2f(MPI_COMM_SPLIT);
+  phase_times[PHASE_SPLIT] = Now() - start;
+
+  SetRankEnvironment(params, ColorRank(), 1);
+
+  ProfileInit(params->out_err_filename);
+  TimelineStart(params->color);
+  TraceInit(params->color);
+  UsageInit(params->color);
+  HeartbeatInit(params->out_err_filename, ColorRank());
+
+  free(params);
+}
+
+// Reduce startup phase times over MPI_COMM_WORLD and have rank 0 write
+// the min/avg/max and slowest rank of each phase to W_TIMING_FILE
+static void ReportStartupTimes() {
+  const char *const file_name = getenv("W_TIMING_FILE");
+  if(!file_name)
+    return;
+
+  int rank, size;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  PMPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // The last entry is the total startup time
+  double times[PHASE_COUNT+1];
+  struct { double time; int rank; } times_rank[PHASE_COUNT+1], max_times[PHASE_COUNT+1];
+  double min_times[PHASE_COUNT+1], sum_times[PHASE_COUNT+1];
+  int i;
+  times[PHASE_COUNT] = 0.0;
+  for(i=0; i<PHASE_COUNT; i++) {
+    times[i] = phase_times[i];
+    times[PHASE_COUNT] += phase_times[i];
+  }
+  for(i=0; i<=PHASE_COUNT; i++) {
+    times_rank[i].time = times[i];
+    times_rank[i].rank = rank;
+  }
+
+  PMPI_Reduce(times, min_times, PHASE_COUNT+1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+  PMPI_Reduce(times, sum_times, PHASE_COUNT+1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  PMPI_Reduce(times_rank, max_times, PHASE_COUNT+1, MPI_DOUBLE_INT, MPI_MAXLOC, 0, MPI_COMM_WORLD);
+
+  if(rank != 0)
+    return;
+
+  FILE *const file = fopen(file_name, "w");
+  if(!file) {
+    fprintf(stderr, "ERROR OPENING TIMING FILE %s: %s\n", file_name, strerror(errno));
+    return;
+  }
+
+  fprintf(file, "# wraprun startup times over %d ranks\n", size);
+  fprintf(file, "%-8s %12s %12s %12s %12s\n", "phase", "min (s)", "avg (s)", "max (s)", "slowest rank");
+  for(i=0; i<=PHASE_COUNT; i++)
+    fprintf(file, "%-8s %12.6f %12.6f %12.6f %12d\n", i < PHASE_COUNT ? PHASE_NAMES[i] : "total",
+            min_times[i], sum_times[i]/size, max_times[i].time, max_times[i].rank);
 
-  SetWorkingDirectory(work_dir);
+  fclose(file);
+}
 
-  if (getenv("W_REDIRECT_OUTERR"))
-    SetStdOutErr(out_err_filename);
+#if MPI_VERSION >= 4
+static void ChainNextSessionMPI();
+#endif
 
-  SetEnvironmentVaribles(env_vars);
+// W_PMPI_CHAIN passes calls on to the next MPI_* implementation, e.g. a PMPI
+// tool preloaded after libsplit, rather than straight to PMPI_*
+static int ChainPMPI() {
+  if(!getenv("W_PMPI_CHAIN"))
+    return 0;
 
-  free(work_dir);
-  free(out_err_filename);
-  free(env_vars);
+  ChainNextMPI();
+  ChainNextFortranMPI();
+#if MPI_VERSION >= 4
+  ChainNextSessionMPI();
+#endif
+  return 1;
 }
 
 int MPI_Init(int *argc, char ***argv) {
   // Allow MPI_Init to be called directly
   int return_value;
-  if (getenv("W_UNWRAP_INIT")) {
+  const double start = Now();
+  if (ChainPMPI() || getenv("W_UNWRAP_INIT")) {
     int (*real_MPI_Init)(int*, char***) = dlsym(RTLD_NEXT, "MPI_Init");
     return_value = (*real_MPI_Init)(argc, argv);
     DEBUG_PRINT("Unwrapped!\n");
@@ -277,6 +847,7 @@ int MPI_Init(int *argc, char ***argv) {
     return_value = PMPI_Init(argc, argv);
     DEBUG_PRINT("Wrapped!\n");
   }
+  phase_times[PHASE_INIT] = Now() - start;
 
   SplitInit();
   return return_value;
@@ -285,7 +856,8 @@ int MPI_Init(int *argc, char ***argv) {
 int MPI_Init_thread(int *argc, char ***argv, int required, int *provided) {
   // Allow MPI_Init_thread to be called directly
   int return_value;
-  if (getenv("W_UNWRAP_INIT")) {
+  const double start = Now();
+  if (ChainPMPI() || getenv("W_UNWRAP_INIT")) {
     DEBUG_PRINT("Unwrapped!\n");
     int (*real_MPI_Init_thread)(int*, char***, int, int*) = dlsym(RTLD_NEXT, "MPI_Init_thread");
     return_value = (*real_MPI_Init_thread)(argc, argv, required, provided);
@@ -294,12 +866,28 @@ int MPI_Init_thread(int *argc, char ***argv, int required, int *provided) {
     DEBUG_PRINT("Wrapped!\n");
     return_value = PMPI_Init_thread(argc, argv, required, provided);
   }
+  phase_times[PHASE_INIT] = Now() - start;
 
   SplitInit();
   return return_value;
 }
 
 int MPI_Finalize() {
+  TimelineEnd();
+  ProfileStop();
+  StopHeartbeat();
+
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if(!finalized) {
+    ReportStartupTimes();
+    ReportTimeline();
+    ReportProfile(split_deferred ? MPI_COMM_SELF : MPI_COMM_SPLIT);
+    ReportUsage(split_deferred ? MPI_COMM_SELF : MPI_COMM_SPLIT);
+    ReportTrace();
+  }
+
+  split_deferred = 0;
   if(MPI_COMM_SPLIT != MPI_COMM_NULL) {
     const int err = PMPI_Comm_free(&MPI_COMM_SPLIT);
     if(err != MPI_SUCCESS)
@@ -307,11 +895,9 @@ int MPI_Finalize() {
   }
 
   int return_value = 0;
-  int finalized = 0;
-  MPI_Finalized(&finalized);
   if(!finalized) {
     // Allow MPI_Finalize to be called directly
-    if (getenv("W_UNWRAP_FINALIZE")) {
+    if (getenv("W_UNWRAP_FINALIZE") || getenv("W_PMPI_CHAIN")) {
       DEBUG_PRINT("Unwrapped!\n");
       int (*real_MPI_Finalize)() = dlsym(RTLD_NEXT, "MPI_Finalize");
       return_value = (*real_MPI_Finalize)();
@@ -322,1271 +908,318 @@ int MPI_Finalize() {
     }
   }
 
+  StopForwarding();
   CloseStdOutErr();
+  StageOut();
 
   return return_value;
 }
 
-// If input_comm == MPI_COMM_WORLD return MPI_COMM_SPLIT else input_comm
-// MPI standard guarantees opaque types comparable and assignable
-static MPI_Comm GetCorrectComm(const MPI_Comm input_comm) {
-  MPI_Comm correct_comm;
-  if(input_comm == MPI_COMM_WORLD)
-    correct_comm = MPI_COMM_SPLIT;
-  else
-    correct_comm = input_comm;
-
-  return correct_comm;
-}
-
 ///////////////////////////////////////////////////////////////////////////////
-///// Simple MPI wrapper functions
+///// MPI Sessions
 //////////////////////////////////////////////////////////////////////////////
-int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-             MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Send(buf, count, datatype, dest, tag, correct_comm);
-}
-
-int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag,
-             MPI_Comm comm, MPI_Status *status) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Recv(buf, count, datatype, source, tag, correct_comm, status);
-}
-
-int MPI_Bsend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-             MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Bsend(buf, count, datatype, dest, tag, correct_comm);
-}
-
-int MPI_Ssend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-             MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ssend(buf, count, datatype, dest, tag, correct_comm);
-}
-
-int MPI_Rsend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-             MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Rsend(buf, count, datatype, dest, tag, correct_comm);
-}
-
-int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-              MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Isend(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Ibsend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-              MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ibsend(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Issend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-              MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Issend(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Irsend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag,
-              MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Irsend(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source,
-              int tag, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Irecv(buf, count, datatype, source, tag, correct_comm, request);
-}
-
-int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iprobe(source, tag, correct_comm, flag, status);
-}
-
-int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Probe(source, tag, correct_comm, status);
-}
-
-int MPI_Send_init(const void *buf, int count, MPI_Datatype datatype, int dest,
-                 int tag, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Send_init(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Bsend_init(const void *buf, int count, MPI_Datatype datatype, int dest,
-                 int tag, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Bsend_init(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Ssend_init(const void *buf, int count, MPI_Datatype datatype, int dest,
-                 int tag, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ssend_init(buf, count, datatype, dest, tag, correct_comm, request);
-}
-
-int MPI_Rsend_init(const void *buf, int count, MPI_Datatype datatype, int dest,
-                 int tag, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+// Session based applications build communicators from process sets instead of
+// MPI_COMM_WORLD. The mpi://WORLD process set is switched out for the world
+// ranks sharing the calling rank's color, also published as wraprun://color,
+// so communicators created from it span only the rank's task
+#if MPI_VERSION >= 4
+
+#define WORLD_PSET "mpi://WORLD"
+#define COLOR_PSET "wraprun://color"
+
+// Set by the first MPI_Session_init from WRAPRUN_FILE
+static int *color_ranks = NULL;
+static int color_rank_count = 0;
+static int session_color = 0;
+static int session_color_count = 0;
+static pthread_mutex_t session_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The session routines take no communicator so aren't generated, they are
+// chained the same way as the generated wrappers
+static __typeof__(PMPI_Session_init) *next_MPI_Session_init = PMPI_Session_init;
+static __typeof__(PMPI_Group_from_session_pset) *next_MPI_Group_from_session_pset =
+  PMPI_Group_from_session_pset;
+static __typeof__(PMPI_Session_get_num_psets) *next_MPI_Session_get_num_psets =
+  PMPI_Session_get_num_psets;
+static __typeof__(PMPI_Session_get_nth_pset) *next_MPI_Session_get_nth_pset =
+  PMPI_Session_get_nth_pset;
+static __typeof__(PMPI_Session_get_pset_info) *next_MPI_Session_get_pset_info =
+  PMPI_Session_get_pset_info;
+
+#define SESSION_CHAIN_NEXT(name) do { \
+  void *next = dlsym(RTLD_NEXT, #name); \
+  if(next) \
+    next_##name = next; \
+} while(0)
+
+static void ChainNextSessionMPI() {
+  SESSION_CHAIN_NEXT(MPI_Session_init);
+  SESSION_CHAIN_NEXT(MPI_Group_from_session_pset);
+  SESSION_CHAIN_NEXT(MPI_Session_get_num_psets);
+  SESSION_CHAIN_NEXT(MPI_Session_get_nth_pset);
+  SESSION_CHAIN_NEXT(MPI_Session_get_pset_info);
+}
+
+// Add the rank_count world ranks from first_rank to the color's ranks if color
+// is the rank's, and count colors up to the largest
+static void AddColorRanks(const int color, const int first_rank, const int rank_count) {
+  if(color + 1 > session_color_count)
+    session_color_count = color + 1;
+  if(color != session_color)
+    return;
 
-  return PMPI_Rsend_init(buf, count, datatype, dest, tag, correct_comm, request);
-}
+  int i;
+  for(i=0; i<rank_count; i++)
+    color_ranks[color_rank_count++] = first_rank + i;
+}
+
+// Find the world ranks sharing params' color and count the colors of the
+// bundle, as the largest color plus one. Indexed files hold rank ranges, of
+// which a color may have several, text files are searched line by line
+static void SetColorRanks(const ParamFile *const file, const RankParams *const params,
+                          const int world_size) {
+  session_color = params->color;
+  color_ranks = malloc(world_size * sizeof(int));
+  if(!color_ranks)
+    EXIT_PRINT("Error allocating color rank memory!\n");
+
+  uint32_t i;
+  if(file->indexed) {
+    // The range table and records were checked by GetRankParams
+    const uint32_t range_count = ReadU32(file->data + 16);
+    const char *const ranges = file->data + INDEX_HEADER_SIZE;
+    for(i=0; i<range_count; i++) {
+      const char *const range = ranges + (size_t)i*INDEX_RANGE_SIZE;
+      const uint64_t offset = ReadU64(range + 8);
+      if(offset > file->size || file->size - offset < INDEX_RECORD_SIZE)
+        EXIT_PRINT("Truncated WRAPRUN_FILE record for range %u\n", i);
+      AddColorRanks((int)ReadU32(file->data + offset), (int)ReadU32(range),
+                    (int)ReadU32(range + 4));
+    }
+    return;
+  }
 
-int MPI_Recv_init(void *buf, int count, MPI_Datatype datatype, int source,
-                 int tag, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
+  RankParams *const entry_params = malloc(sizeof(RankParams));
+  if(!entry_params)
+    EXIT_PRINT("Error allocating color rank memory!\n");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+  for(i=0; i<(uint32_t)world_size; i++) {
+    GetRankParams(file, i, entry_params);
+    AddColorRanks(entry_params->color, i, 1);
+  }
 
-  return PMPI_Recv_init(buf, count, datatype, source, tag, correct_comm, request);
+  free(entry_params);
 }
 
-int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                int dest, int sendtag,
-                void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                int source, int recvtag,
-                MPI_Comm comm, MPI_Status *status) {
-
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag,
-                       recvbuf, recvcount, recvtype, source, recvtag,
-                       correct_comm, status);
+// The rank's rank in the color group, its index among the color's world ranks,
+// as MPI_COMM_SPLIT isn't created for session based ranks
+static int SessionColorRank(const int rank) {
+  int i;
+  for(i=0; i<color_rank_count; i++)
+    if(color_ranks[i] == rank)
+      return i;
+  return 0;
 }
 
-int MPI_Sendrecv_replace(void *buf, int count, MPI_Datatype datatype,
-                       int dest, int sendtag, int source, int recvtag,
-                       MPI_Comm comm, MPI_Status *status) {
-  DEBUG_PRINT("Wrapped!\n");
+// On the first MPI_Session_init read the rank's parameters using its rank in
+// mpi://WORLD, and set up the rank as SplitInit() would if MPI_Init hasn't
+static void SessionSplitInit(const MPI_Session session) {
+  pthread_mutex_lock(&session_mutex);
+  if(color_ranks) {
+    pthread_mutex_unlock(&session_mutex);
+    return;
+  }
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+  // Entries looked up by W_ENV_RANK don't describe world ranks
+  if(getenv("W_RANK_FROM_ENV"))
+    EXIT_PRINT("W_RANK_FROM_ENV is not supported with MPI Sessions\n");
 
-  return PMPI_Sendrecv_replace(buf, count, datatype, dest, sendtag, source,
-                               recvtag, correct_comm, status);
-}
+  MPI_Group world_group;
+  const int err = PMPI_Group_from_session_pset(session, WORLD_PSET, &world_group);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to get %s group: %d!\n", WORLD_PSET, err);
 
-int MPI_Pack(const void *inbuf,
-             int incount,
-             MPI_Datatype datatype,
-             void *outbuf,
-             int outsize,
-             int *position,
-             MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
+  int rank, size;
+  PMPI_Group_rank(world_group, &rank);
+  PMPI_Group_size(world_group, &size);
+  PMPI_Group_free(&world_group);
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+  RankParams *const params = calloc(1, sizeof(RankParams));
+  if(!params)
+    EXIT_PRINT("Error allocating rank parameter memory!\n");
 
-  return PMPI_Pack(inbuf, incount, datatype,
-                   outbuf, outsize, position, correct_comm);
+  ParamFile file;
+  OpenParamFile(&file);
+  GetRankParams(&file, rank, params);
+  SetColorRanks(&file, params, size);
+  CloseParamFile(&file);
 
-}
+  if(!split_initialized) {
+    split_initialized = 1;
 
-int MPI_Unpack(const void *inbuf, int insize, int *position,
-               void *outbuf, int outcount, MPI_Datatype datatype,
-               MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
+    if (getenv("W_UNSET_PRELOAD"))
+      unsetenv("LD_PRELOAD");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+    AppendApidToStdio(params);
+    SetRankEnvironment(params, SessionColorRank(rank), 0);
+  }
 
-  return PMPI_Unpack(inbuf, insize, position, outbuf, outcount,
-                     datatype, correct_comm);
+  free(params);
+  pthread_mutex_unlock(&session_mutex);
 }
 
-int MPI_Pack_size(int incount, MPI_Datatype datatype, MPI_Comm comm, int *size) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Pack_size(incount, datatype, correct_comm, size);
+static int IsColorPset(const char *const pset_name) {
+  return strcmp(pset_name, WORLD_PSET) == 0 || strcmp(pset_name, COLOR_PSET) == 0;
 }
 
-int MPI_Barrier(MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+// Groups may only be used with the session they came from, so the color group
+// is built from each session's own mpi://WORLD
+static int CreateSessionColorGroup(const MPI_Session session, MPI_Group *newgroup) {
+  MPI_Group world_group;
+  int err = PMPI_Group_from_session_pset(session, WORLD_PSET, &world_group);
+  if(err != MPI_SUCCESS)
+    return err;
 
-  return PMPI_Barrier(correct_comm);
+  err = PMPI_Group_incl(world_group, color_rank_count, color_ranks, newgroup);
+  PMPI_Group_free(&world_group);
+  return err;
 }
 
-int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+int MPI_Session_init(MPI_Info info, MPI_Errhandler errhandler, MPI_Session *session) {
   DEBUG_PRINT("Wrapped!\n");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Bcast(buffer, count, datatype, root, correct_comm);
+  ChainPMPI();
+  const int err = next_MPI_Session_init(info, errhandler, session);
+  if(err == MPI_SUCCESS)
+    SessionSplitInit(*session);
+  return err;
 }
 
-int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-    void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
-    MPI_Comm comm) {
+int MPI_Group_from_session_pset(MPI_Session session, const char *pset_name,
+                                MPI_Group *newgroup) {
   DEBUG_PRINT("Wrapped!\n");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                     root, correct_comm);
+  if(IsColorPset(pset_name))
+    return CreateSessionColorGroup(session, newgroup);
+  return next_MPI_Group_from_session_pset(session, pset_name, newgroup);
 }
 
-int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                void *recvbuf, const int *recvcounts, const int *displs,
-                MPI_Datatype recvtype, int root, MPI_Comm comm) {
+// wraprun://color is listed after the MPI library's own process sets
+int MPI_Session_get_num_psets(MPI_Session session, MPI_Info info, int *npset_names) {
   DEBUG_PRINT("Wrapped!\n");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts,
-                      displs, recvtype, root, correct_comm);
+  const int err = next_MPI_Session_get_num_psets(session, info, npset_names);
+  if(err == MPI_SUCCESS)
+    (*npset_names)++;
+  return err;
 }
 
-int MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-               void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
-               MPI_Comm comm) {
-
+int MPI_Session_get_nth_pset(MPI_Session session, MPI_Info info, int n, int *pset_len,
+                             char *pset_name) {
   DEBUG_PRINT("Wrapped!\n");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount,
-                      recvtype, root, correct_comm);
+  int library_psets;
+  const int err = next_MPI_Session_get_num_psets(session, info, &library_psets);
+  if(err != MPI_SUCCESS || n != library_psets)
+    return next_MPI_Session_get_nth_pset(session, info, n, pset_len, pset_name);
 
+  // A pset_len of 0 asks for the length of the name, otherwise at most pset_len
+  // characters are written, and either way pset_len is set to the name's
+  // length including the terminator so a caller can tell it was truncated
+  if(*pset_len > 0)
+    snprintf(pset_name, *pset_len, "%s", COLOR_PSET);
+  *pset_len = sizeof(COLOR_PSET);
+  return MPI_SUCCESS;
 }
 
-int MPI_Scatterv(const void *sendbuf, const int *sendcounts, const int *displs,
-                 MPI_Datatype sendtype, void *recvbuf, int recvcount,
-                 MPI_Datatype recvtype,
-                 int root, MPI_Comm comm) {
+// The color process sets report the color's size as mpi_size, along with the
+// rank's color as wraprun_color and the number of colors as wraprun_colors
+int MPI_Session_get_pset_info(MPI_Session session, const char *pset_name, MPI_Info *info) {
   DEBUG_PRINT("Wrapped!\n");
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+  if(!IsColorPset(pset_name))
+    return next_MPI_Session_get_pset_info(session, pset_name, info);
 
-  return PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount,
-                      recvtype, root, correct_comm);
+  int err = next_MPI_Session_get_pset_info(session, WORLD_PSET, info);
+  if(err != MPI_SUCCESS)
+    return err;
+
+  const char *const keys[] = {"mpi_size", "wraprun_color", "wraprun_colors"};
+  const int values[] = {color_rank_count, session_color, session_color_count};
+  int i;
+  for(i=0; i<3 && err == MPI_SUCCESS; i++) {
+    char value[16];
+    snprintf(value, sizeof(value), "%d", values[i]);
+    err = PMPI_Info_set(*info, keys[i], value);
+  }
+  return err;
 }
 
-int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                  MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+#endif
 
-  return PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                        correct_comm);
-}
+///////////////////////////////////////////////////////////////////////////////
+///// Fortran MPI_Init and MPI_Finalize
+//////////////////////////////////////////////////////////////////////////////
+// The MPI library's Fortran PMPI_Init, or with W_PMPI_CHAIN the next Fortran
+// MPI_Init, sets up Fortran specific state, such as the MPI_BOTTOM and
+// MPI_STATUS_IGNORE sentinels, before SplitInit() runs
+// The remaining Fortran wrappers are generated in split_fortran.c
+// A weak pmpi_name left unresolved at load is looked up again, failing
+// rather than calling through NULL
+#define FORTRAN_INIT_LOOKUP(init, pmpi_name) \
+    if(!init) \
+      init = dlsym(RTLD_NEXT, #pmpi_name); \
+    if(!init) \
+      EXIT_PRINT("Fortran " #pmpi_name " not found in the MPI library!\n");
+
+#define FORTRAN_INIT(name, pmpi_name) \
+  extern void pmpi_name(MPI_Fint *ierror) __attribute__((weak)); \
+  void name(MPI_Fint *ierror) { \
+    DEBUG_PRINT("Wrapped!\n"); \
+    const double start = Now(); \
+    void (*init)(MPI_Fint*) = ChainPMPI() ? dlsym(RTLD_NEXT, #name) : pmpi_name; \
+    FORTRAN_INIT_LOOKUP(init, pmpi_name) \
+    init(ierror); \
+    phase_times[PHASE_INIT] = Now() - start; \
+    SplitInit(); \
+  }
 
-int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                   void *recvbuf, const int *recvcounts, const int *displs,
-                   MPI_Datatype recvtype, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
+#define FORTRAN_INIT_THREAD(name, pmpi_name) \
+  extern void pmpi_name(MPI_Fint *required, MPI_Fint *provided, MPI_Fint *ierror) \
+    __attribute__((weak)); \
+  void name(MPI_Fint *required, MPI_Fint *provided, MPI_Fint *ierror) { \
+    DEBUG_PRINT("Wrapped!\n"); \
+    const double start = Now(); \
+    void (*init)(MPI_Fint*, MPI_Fint*, MPI_Fint*) = ChainPMPI() ? dlsym(RTLD_NEXT, #name) \
+                                                                : pmpi_name; \
+    FORTRAN_INIT_LOOKUP(init, pmpi_name) \
+    init(required, provided, ierror); \
+    phase_times[PHASE_INIT] = Now() - start; \
+    SplitInit(); \
+  }
 
-  MPI_Comm correct_comm = GetCorrectComm(comm);
+// ierror is optional with mpi_f08
+#define FORTRAN_FINALIZE(name) \
+  void name(MPI_Fint *ierror) { \
+    const int err = MPI_Finalize(); \
+    if(ierror) \
+      *ierror = err; \
+  }
 
-  return PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
-                        recvtype, correct_comm);
-}
-
-int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                 void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                 MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount,
-                       recvtype, correct_comm);
-}
-
-int MPI_Alltoallv(const void *sendbuf, const int *sendcounts,
-                  const int *sdispls, MPI_Datatype sendtype, void *recvbuf,
-                  const int *recvcounts, const int *rdispls, MPI_Datatype recvtype,
-                  MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Alltoallv(sendbuf, sendcounts,
-                        sdispls, sendtype, recvbuf,
-                        recvcounts, rdispls, recvtype,
-                        correct_comm);
-}
-
-int MPI_Alltoallw(const void *sendbuf, const int sendcounts[],
-                  const int sdispls[], const MPI_Datatype sendtypes[],
-                  void *recvbuf, const int recvcounts[], const int rdispls[],
-                  const MPI_Datatype recvtypes[], MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Alltoallw(sendbuf, sendcounts,
-                        sdispls, sendtypes,
-                        recvbuf, recvcounts, rdispls,
-                        recvtypes, correct_comm);
-}
-
-int MPI_Exscan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
-               MPI_Op op, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Exscan(sendbuf, recvbuf, count, datatype, op, correct_comm);
-}
-
-int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
-               MPI_Op op, int root, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Reduce(sendbuf, recvbuf, count, datatype,
-                    op, root, correct_comm);
-}
-
-int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
-                  MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Allreduce(sendbuf, recvbuf, count,
-                        datatype, op, correct_comm);
-}
-
-int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[],
-                      MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts,
-                             datatype, op, correct_comm);
-}
-
-int MPI_Scan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
-             MPI_Op op, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Scan(sendbuf, recvbuf, count, datatype,
-                   op, correct_comm);
-}
-
-int MPI_Comm_group(MPI_Comm comm, MPI_Group *group) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_group(correct_comm, group);
-}
-
-int MPI_Comm_size(MPI_Comm comm, int *size) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_size(correct_comm, size);
-}
-
-int MPI_Comm_rank(MPI_Comm comm, int *rank) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_rank(correct_comm, rank);
-}
-
-int MPI_Comm_compare(MPI_Comm comm1, MPI_Comm comm2, int *result) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm1 = GetCorrectComm(comm1);
-
-  MPI_Comm correct_comm2 = GetCorrectComm(comm2);
-
-  return PMPI_Comm_compare(correct_comm1, correct_comm2, result);
-}
-
-int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_dup(correct_comm, newcomm);
-}
-
-int MPI_Comm_dup_with_info(MPI_Comm comm, MPI_Info info, MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_dup_with_info(correct_comm, info, newcomm);
-}
-
-int MPI_Comm_create(MPI_Comm comm, MPI_Group group, MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_create(correct_comm, group, newcomm);
-}
-
-int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_split(correct_comm, color, key, newcomm);
-}
-
-// Not needed, shouldn't ever free MPI_COMM_WORLD
-int MPI_Comm_free(MPI_Comm *comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  return PMPI_Comm_free(comm);
-}
-
-int MPI_Comm_test_inter(MPI_Comm comm, int *flag) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_test_inter(correct_comm, flag);
-}
-
-int MPI_Comm_remote_size(MPI_Comm comm, int *size) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_remote_size(correct_comm, size);
-}
-
-int MPI_Comm_remote_group(MPI_Comm comm, MPI_Group *group) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_remote_group(correct_comm, group);
-}
-
-int MPI_Intercomm_create(MPI_Comm local_comm, int local_leader,
-                       MPI_Comm peer_comm, int remote_leader, int tag,
-                       MPI_Comm *newintercomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_local_comm = GetCorrectComm(local_comm);
-  MPI_Comm correct_peer_comm = GetCorrectComm(peer_comm);
-
-  return PMPI_Intercomm_create(correct_local_comm, local_leader,
-                               correct_peer_comm, remote_leader, tag,
-                               newintercomm);
-}
-
-int MPI_Intercomm_merge(MPI_Comm intercomm, int high, MPI_Comm *newintracomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_intercomm = GetCorrectComm(intercomm);
-
-  return PMPI_Intercomm_merge(correct_intercomm, high, newintracomm);
-}
-
-int MPI_Attr_put(MPI_Comm comm, int keyval, void *attribute_val) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Attr_put(correct_comm, keyval, attribute_val);
-}
-
-int MPI_Attr_get(MPI_Comm comm, int keyval, void *attribute_val, int *flag) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Attr_get(correct_comm, keyval, attribute_val, flag);
-}
-
-int MPI_Attr_delete(MPI_Comm comm, int keyval) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Attr_delete(correct_comm, keyval);
-}
-
-int MPI_Topo_test(MPI_Comm comm, int *status) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Topo_test(correct_comm, status);
-}
-
-int MPI_Cart_create(MPI_Comm comm_old, int ndims, const int dims[],
-                    const int periods[], int reorder, MPI_Comm *comm_cart) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm_old = GetCorrectComm(comm_old);
-
-  return PMPI_Cart_create(correct_comm_old, ndims, dims, periods, reorder, comm_cart);
-}
-int MPI_Graph_create(MPI_Comm comm_old, int nnodes, const int indx[],
-                     const int edges[], int reorder, MPI_Comm *comm_graph) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm_old = GetCorrectComm(comm_old);
-
-  return PMPI_Graph_create(correct_comm_old, nnodes, indx, edges, reorder, comm_graph);
-}
-
-int MPI_Graphdims_get(MPI_Comm comm, int *nnodes, int *nedges) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Graphdims_get(correct_comm, nnodes, nedges);
-}
-
-int MPI_Graph_get(MPI_Comm comm, int maxindex, int maxedges, int indx[], int edges[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Graph_get(correct_comm, maxindex, maxedges, indx, edges);
-}
-
-int MPI_Cartdim_get(MPI_Comm comm, int *ndims) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cartdim_get(correct_comm, ndims);
-}
-
-int MPI_Cart_get(MPI_Comm comm, int maxdims, int dims[], int periods[], int coords[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cart_get(correct_comm, maxdims, dims, periods, coords);
-}
-
-int MPI_Cart_rank(MPI_Comm comm, const int coords[], int *rank) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cart_rank(correct_comm, coords, rank);
-}
-
-int MPI_Cart_coords(MPI_Comm comm, int rank, int maxdims, int coords[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cart_coords(correct_comm, rank, maxdims, coords);
-}
-
-int MPI_Graph_neighbors_count(MPI_Comm comm, int rank, int *nneighbors) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Graph_neighbors_count(correct_comm, rank, nneighbors);
-}
-
-int MPI_Graph_neighbors(MPI_Comm comm, int rank, int maxneighbors, int neighbors[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Graph_neighbors(correct_comm, rank, maxneighbors, neighbors);
-}
-
-int MPI_Cart_shift(MPI_Comm comm, int direction, int disp, int *rank_source, int *rank_dest) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cart_shift(correct_comm, direction, disp, rank_source, rank_dest);
-}
-int MPI_Cart_sub(MPI_Comm comm, const int remain_dims[], MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cart_sub(correct_comm, remain_dims, newcomm);
-}
-
-int MPI_Cart_map(MPI_Comm comm, int ndims, const int dims[], const int periods[], int *newrank) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Cart_map(correct_comm, ndims, dims, periods, newrank);
-}
-
-int MPI_Graph_map(MPI_Comm comm, int nnodes, const int indx[], const int edges[], int *newrank) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Graph_map(correct_comm, nnodes, indx, edges, newrank);
-}
-
-int MPI_Errhandler_set(MPI_Comm comm, MPI_Errhandler errhandler) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Errhandler_set(correct_comm, errhandler);
-}
-
-int MPI_Errhandler_get(MPI_Comm comm, MPI_Errhandler *errhandler) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Errhandler_get(correct_comm, errhandler);
-}
-
-int MPI_Abort(MPI_Comm comm, int errorcode) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Abort(correct_comm, errorcode);
-}
-
-/*
-int MPI_DUP_FN(MPI_Comm comm, int key, void *extra,
-        void *attrin, void *attrout, int *flag) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_DUP_FN(correct_comm, key, extra, attrin, attrout, flag);
-}
-*/
-
-int MPI_Comm_connect(const char *port_name, MPI_Info info, int root, MPI_Comm comm,
-                     MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_connect(port_name, info ,root, correct_comm, newcomm);
-}
-
-// Not needed, shouldn't ever free MPI_COMM_WORLD
-int MPI_Comm_disconnect(MPI_Comm *comm) {
-  DEBUG_PRINT("Wrapped!\n");
-  return PMPI_Comm_disconnect(comm);
-}
-
-int MPI_Comm_spawn(const char *command, char *argv[], int maxprocs, MPI_Info info,
-                  int root, MPI_Comm comm, MPI_Comm *intercomm,
-                  int array_of_errcodes[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_spawn(command, argv, maxprocs, info,
-                         root, correct_comm, intercomm, array_of_errcodes);
-}
-int MPI_Comm_spawn_multiple(int count, char *array_of_commands[],
-                          char **array_of_argv[], const int array_of_maxprocs[],
-                          const MPI_Info array_of_info[], int root, MPI_Comm comm,
-                          MPI_Comm *intercomm, int array_of_errcodes[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_spawn_multiple(count, array_of_commands,
-                            array_of_argv, array_of_maxprocs,
-                            array_of_info, root, correct_comm,
-                            intercomm, array_of_errcodes);
-}
-
-int MPI_Comm_set_info(MPI_Comm comm, MPI_Info info) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_set_info(correct_comm, info);
-}
-
-int MPI_Comm_get_info(MPI_Comm comm, MPI_Info *info) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_get_info(correct_comm, info);
-}
-
-int MPI_Win_create(void *base, MPI_Aint size, int disp_unit, MPI_Info info,
-                  MPI_Comm comm, MPI_Win *win) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Win_create(base, size, disp_unit, info, correct_comm, win);
-}
-
-int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info,
-                  MPI_Comm comm, void *baseptr, MPI_Win *win) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Win_allocate(size, disp_unit, info, correct_comm, baseptr, win);
-}
-
-int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm,
-                             void *baseptr, MPI_Win *win) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Win_allocate_shared(size, disp_unit, info, correct_comm, baseptr, win);
-}
-
-int MPI_Win_create_dynamic(MPI_Info info, MPI_Comm comm, MPI_Win *win) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Win_create_dynamic(info, correct_comm, win);
-}
-
-int MPI_Comm_call_errhandler(MPI_Comm comm, int errorcode) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_call_errhandler(correct_comm, errorcode);
-}
-
-int MPI_Comm_delete_attr(MPI_Comm comm, int comm_keyval) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_delete_attr(correct_comm, comm_keyval);
-}
-
-int MPI_Comm_get_attr(MPI_Comm comm, int comm_keyval, void *attribute_val, int *flag) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_get_attr(correct_comm, comm_keyval, attribute_val, flag);
-}
-
-int MPI_Comm_get_name(MPI_Comm comm, char *comm_name, int *resultlen) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_get_name(correct_comm, comm_name, resultlen);
-}
-
-int MPI_Comm_set_attr(MPI_Comm comm, int comm_keyval, void *attribute_val) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_set_attr(correct_comm, comm_keyval, attribute_val);
-}
-
-int MPI_Comm_set_name(MPI_Comm comm, const char *comm_name) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_set_name(correct_comm, comm_name);
-}
-
-int MPI_Comm_get_errhandler(MPI_Comm comm, MPI_Errhandler *errhandler) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_get_errhandler(correct_comm, errhandler);
-}
-
-int MPI_Comm_set_errhandler(MPI_Comm comm, MPI_Errhandler errhandler) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_set_errhandler(correct_comm, errhandler);
-}
-
-int MPI_Reduce_scatter_block(const void *sendbuf, void *recvbuf,
-                             int recvcount,
-                             MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Reduce_scatter_block(sendbuf, recvbuf, recvcount,
-                                   datatype, op, correct_comm);
-}
-
-int MPI_Dist_graph_create_adjacent(MPI_Comm comm_old,
-                                   int indegree, const int sources[],
-                                   const int sourceweights[],
-                                   int outdegree, const int destinations[],
-                                   const int destweights[],
-                                   MPI_Info info, int reorder, MPI_Comm *comm_dist_graph) {
-
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm_old = GetCorrectComm(comm_old);
-
-  return PMPI_Dist_graph_create_adjacent(correct_comm_old, indegree, sources,
-                                         sourceweights, outdegree, destinations,
-                                         destweights, info, reorder, comm_dist_graph);
-
-}
-
-int MPI_Dist_graph_create(MPI_Comm comm_old, int n, const int sources[],
-                          const int degrees[], const int destinations[],
-                          const int weights[],
-                          MPI_Info info, int reorder, MPI_Comm *comm_dist_graph) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm_old = GetCorrectComm(comm_old);
-
-  return PMPI_Dist_graph_create(correct_comm_old, n, sources, degrees, destinations,
-                                weights, info, reorder, comm_dist_graph);
-}
-
-int MPI_Dist_graph_neighbors_count(MPI_Comm comm, int *indegree, int *outdegree, int *weighted) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Dist_graph_neighbors_count(correct_comm, indegree, outdegree, weighted);
-}
-
-int MPI_Dist_graph_neighbors(MPI_Comm comm,
-                             int maxindegree, int sources[], int sourceweights[],
-                             int maxoutdegree, int destinations[], int destweights[]) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Dist_graph_neighbors(correct_comm, maxindegree, sources, sourceweights,
-                                   maxoutdegree, destinations, destweights);
-}
-
-int MPI_Improbe(int source, int tag, MPI_Comm comm, int *flag, MPI_Message *message, MPI_Status *status) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Improbe(source, tag, correct_comm, flag, message, status);
-}
-
-int MPI_Mprobe(int source, int tag, MPI_Comm comm, MPI_Message *message, MPI_Status *status) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Mprobe(source, tag, correct_comm, message, status);
-}
-
-int MPI_Comm_idup(MPI_Comm comm, MPI_Comm *newcomm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_idup(correct_comm, newcomm, request);
-}
-
-int MPI_Ibarrier(MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ibarrier(correct_comm, request);
-}
-
-int MPI_Ibcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ibcast(buffer, count, datatype, root, correct_comm, request);
-}
-
-int MPI_Igather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                int root, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Igather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                      root, correct_comm, request);
-}
-
-int MPI_Igatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
-                 const int recvcounts[], const int displs[], MPI_Datatype recvtype, int root,
-                 MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Igatherv(sendbuf, sendcount, sendtype, recvbuf,
-                       recvcounts, displs, recvtype, root, correct_comm, request);
-}
-
-int MPI_Iscatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
-                 MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iscatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                       root, correct_comm, request);
-}
-
-int MPI_Iscatterv(const void *sendbuf, const int sendcounts[], const int displs[],
-                  MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                  int root, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iscatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype,
-                       root, correct_comm, request);
-}
-
-int MPI_Iallgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                   void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                   MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iallgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                         correct_comm, request);
-}
-
-int MPI_Iallgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
-                    const int recvcounts[], const int displs[], MPI_Datatype recvtype,
-                    MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iallgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype,
-                          correct_comm, request);
-}
-
-int MPI_Ialltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                  MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ialltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                        correct_comm, request);
-}
-
-int MPI_Ialltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
-                   MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
-                   const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ialltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts,
-                         rdispls, recvtype, correct_comm, request);
-}
-
-int MPI_Ialltoallw(const void *sendbuf, const int sendcounts[], const int sdispls[],
-                   const MPI_Datatype sendtypes[], void *recvbuf, const int recvcounts[],
-                   const int rdispls[], const MPI_Datatype recvtypes[], MPI_Comm comm,
-                   MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ialltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts,
-                         rdispls, recvtypes, correct_comm, request);
-}
-
-int MPI_Ireduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
-                MPI_Op op, int root, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ireduce(sendbuf, recvbuf, count, datatype, op, root, correct_comm, request);
-}
-
-int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count,
-                   MPI_Datatype datatype, MPI_Op op, MPI_Comm comm,
-                   MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, correct_comm, request);
-}
-
-int MPI_Ireduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[],
-                        MPI_Datatype datatype, MPI_Op op, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ireduce_scatter(sendbuf, recvbuf, recvcounts, datatype, op, correct_comm, request);
-}
-
-int MPI_Ireduce_scatter_block(const void *sendbuf, void *recvbuf,
-                              int recvcount,
-                              MPI_Datatype datatype, MPI_Op op, MPI_Comm comm,
-                              MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ireduce_scatter_block(sendbuf, recvbuf, recvcount, datatype, op, correct_comm, request);
-}
-
-int MPI_Iscan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
-              MPI_Op op, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iscan(sendbuf, recvbuf, count, datatype, op, correct_comm, request);
-}
-
-int MPI_Iexscan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype,
-                MPI_Op op, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Iexscan(sendbuf, recvbuf, count, datatype, op, correct_comm, request);
-}
-
-int MPI_Ineighbor_allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                            void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                            MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ineighbor_allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                                  correct_comm, request);
-}
-
-int MPI_Ineighbor_allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                             void *recvbuf, const int recvcounts[], const int displs[],
-                             MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ineighbor_allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
-                                   recvtype, correct_comm, request);
-}
-
-int MPI_Ineighbor_alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                           void *recvbuf, int recvcount, MPI_Datatype recvtype,
-                           MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ineighbor_alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                                 correct_comm, request);
-}
-
-int MPI_Ineighbor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
-                            MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
-                            const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ineighbor_alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts,
-                           rdispls, recvtype, correct_comm, request);
-}
-
-int MPI_Ineighbor_alltoallw(const void *sendbuf, const int sendcounts[], const MPI_Aint sdispls[],
-                            const MPI_Datatype sendtypes[], void *recvbuf, const int recvcounts[],
-                            const MPI_Aint rdispls[], const MPI_Datatype recvtypes[],
-                            MPI_Comm comm, MPI_Request *request) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Ineighbor_alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts,
-                                  rdispls, recvtypes, correct_comm, request);
-}
-
-int MPI_Neighbor_allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                           void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Neighbor_allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount,
-                                 recvtype, correct_comm);
-}
-
-int MPI_Neighbor_allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                            void *recvbuf, const int recvcounts[], const int displs[],
-                            MPI_Datatype recvtype, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Neighbor_allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
-                                  recvtype, correct_comm);
-}
-
-int MPI_Neighbor_alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
-                          void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Neighbor_alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, correct_comm);
-}
-
-int MPI_Neighbor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[],
-                           MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
-                           const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Neighbor_alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts,
-                                 rdispls, recvtype, correct_comm);
-}
-
-int MPI_Neighbor_alltoallw(const void *sendbuf, const int sendcounts[], const MPI_Aint sdispls[],
-                           const MPI_Datatype sendtypes[], void *recvbuf, const int recvcounts[],
-                           const MPI_Aint rdispls[], const MPI_Datatype recvtypes[], MPI_Comm comm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Neighbor_alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, correct_comm);
-}
-
-int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_split_type(correct_comm, split_type, key, info, newcomm);
-}
-
-int MPI_Comm_create_group(MPI_Comm comm, MPI_Group group, int tag, MPI_Comm *newcomm) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_Comm_create_group(correct_comm, group, tag, newcomm);
-}
-
-int MPIX_Comm_group_failed(MPI_Comm comm, MPI_Group *failed_group) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPIX_Comm_group_failed(correct_comm, failed_group);
-}
-
-int MPIX_Comm_remote_group_failed(MPI_Comm comm, MPI_Group *failed_group) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPIX_Comm_remote_group_failed(correct_comm, failed_group);
-}
-
-int MPIX_Comm_reenable_anysource(MPI_Comm comm, MPI_Group *failed_group) {
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPIX_Comm_reenable_anysource(correct_comm, failed_group);
-}
-
-int MPI_File_open(MPI_Comm comm, const char *filename, int amode,
-                  MPI_Info info, MPI_File *fh) {
-
-  DEBUG_PRINT("Wrapped!\n");
-
-  MPI_Comm correct_comm = GetCorrectComm(comm);
-
-  return PMPI_File_open(correct_comm, filename, amode, info, fh);
-}
+FORTRAN_INIT(mpi_init_, pmpi_init_)
+FORTRAN_INIT(mpi_init_f08_, pmpi_init_f08_)
+FORTRAN_INIT(MPI_Init_f08, PMPI_Init_f08)
+extern __typeof__(mpi_init_) mpi_init __attribute__((alias("mpi_init_")));
+extern __typeof__(mpi_init_) mpi_init__ __attribute__((alias("mpi_init_")));
+
+FORTRAN_INIT_THREAD(mpi_init_thread_, pmpi_init_thread_)
+FORTRAN_INIT_THREAD(mpi_init_thread_f08_, pmpi_init_thread_f08_)
+FORTRAN_INIT_THREAD(MPI_Init_thread_f08, PMPI_Init_thread_f08)
+extern __typeof__(mpi_init_thread_) mpi_init_thread __attribute__((alias("mpi_init_thread_")));
+extern __typeof__(mpi_init_thread_) mpi_init_thread__ __attribute__((alias("mpi_init_thread_")));
+
+FORTRAN_FINALIZE(mpi_finalize_)
+FORTRAN_FINALIZE(mpi_finalize_f08_)
+FORTRAN_FINALIZE(MPI_Finalize_f08)
+extern __typeof__(mpi_finalize_) mpi_finalize __attribute__((alias("mpi_finalize_")));
+extern __typeof__(mpi_finalize_) mpi_finalize__ __attribute__((alias("mpi_finalize_")));
@@ -0,0 +1,128 @@
+#ifndef WRAPRUN_SRC_SPLIT_H_
+#define WRAPRUN_SRC_SPLIT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "mpi.h"
+
+// State shared between split.c and the generated wrappers, hidden so it isn't
+// exported from libsplit.so
+#define SPLIT_HIDDEN __attribute__((visibility("hidden")))
+
+// Communicator MPI_COMM_WORLD is switched out for, created in SplitInit()
+extern SPLIT_HIDDEN MPI_Comm MPI_COMM_SPLIT;
+
+// Set while W_LAZY_SPLIT has deferred creating MPI_COMM_SPLIT
+extern SPLIT_HIDDEN int split_deferred;
+
+// Fortran handles of MPI_COMM_WORLD and MPI_COMM_SPLIT
+extern SPLIT_HIDDEN MPI_Fint fortran_comm_world;
+extern SPLIT_HIDDEN MPI_Fint fortran_comm_split;
+
+// Create the deferred MPI_COMM_SPLIT, once across all threads
+SPLIT_HIDDEN void CreateDeferredSplit(void);
+
+// Point the generated C and Fortran wrappers at the next implementation of
+// each routine instead of PMPI, defined in split_wrappers.c and split_fortran.c
+SPLIT_HIDDEN void ChainNextMPI(void);
+SPLIT_HIDDEN void ChainNextFortranMPI(void);
+
+// Per call instrumentation enabled at MPI_Init, a mask of INSTRUMENT_* bits
+// While set the generated wrappers time each call and pass it to InstrumentCall()
+#define INSTRUMENT_PROFILE 1
+#define INSTRUMENT_TRACE 2
+#define INSTRUMENT_HEARTBEAT 4
+extern SPLIT_HIDDEN int split_instrument;
+
+// Names and kinds of the wrapped routines indexed by the ROUTINE_* values
+// passed to InstrumentCall(), defined in split_wrappers.c
+enum { ROUTINE_OTHER, ROUTINE_P2P, ROUTINE_COLLECTIVE };
+extern SPLIT_HIDDEN const char *const split_routine_names[];
+extern SPLIT_HIDDEN const unsigned char split_routine_kinds[];
+extern SPLIT_HIDDEN const int split_routine_count;
+
+// Record a call to routine made at start moving count elements of datatype
+SPLIT_HIDDEN void InstrumentCall(int routine, double start, MPI_Count count,
+                                 MPI_Datatype datatype);
+
+// W_PROFILE per routine counters, reported to <out_err_filename>.prof reduced
+// over comm by MPI_Finalize, defined in profile.c
+SPLIT_HIDDEN void ProfileInit(const char *out_err_filename);
+SPLIT_HIDDEN void ProfileStop(void);
+SPLIT_HIDDEN void ReportProfile(MPI_Comm comm);
+
+// W_TIMELINE span of the rank's task, ended on entry to MPI_Finalize and
+// gathered over MPI_COMM_WORLD into a bundle timeline, defined in timeline.c
+SPLIT_HIDDEN void TimelineStart(int color);
+SPLIT_HIDDEN void TimelineEnd(void);
+SPLIT_HIDDEN void ReportTimeline(void);
+
+// W_TRACE ring buffer of the rank's calls, written as a Chrome trace by
+// MPI_Finalize or SIGUSR2, defined in trace.c
+SPLIT_HIDDEN void TraceInit(int color);
+SPLIT_HIDDEN void TraceCall(int routine, double start, double end, uint64_t bytes);
+SPLIT_HIDDEN void ReportTrace(void);
+
+// W_RUSAGE resource usage of the rank, reduced over comm and written a line
+// per color by MPI_Finalize, defined in usage.c
+SPLIT_HIDDEN void UsageInit(int color);
+SPLIT_HIDDEN void ReportUsage(MPI_Comm comm);
+
+// W_HEARTBEAT status records of color rank 0, written by a background thread
+// to <out_err_filename>.status until MPI_Finalize, defined in heartbeat.c
+SPLIT_HIDDEN void HeartbeatInit(const char *out_err_filename, int color_rank);
+SPLIT_HIDDEN void HeartbeatCall(void);
+SPLIT_HIDDEN void StopHeartbeat(void);
+
+// W_FORWARD_OUTERR, W_COMPRESS_OUTERR, W_TAG_OUTERR and W_LAZY_OUTERR pipes of the rank's stdout/stderr, pumped
+// a line at a time to the color's files, or an aggregator per color and node
+// which writes them, until MPI_Finalize, defined in forward.c
+SPLIT_HIDDEN void ForwardStdOutErr(const char *out_err_filename, int color, int color_rank);
+SPLIT_HIDDEN void StopForwarding(void);
+
+// W_STAGE_OUTERR node-local stdout/stderr files, appended to the color's files
+// by MPI_Finalize, defined in stage.c. StreamFileName gives the name of the
+// file to write the stream with suffix out or err to
+SPLIT_HIDDEN void StageInit(void);
+SPLIT_HIDDEN void StreamFileName(char *name, size_t size, const char *out_err_filename,
+                                 const char *suffix);
+SPLIT_HIDDEN void StageOut(void);
+
+// Usable before MPI is initialized, unlike MPI_Wtime
+static inline double Now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + 1.0e-9*time.tv_nsec;
+}
+
+// If input_comm == MPI_COMM_WORLD return MPI_COMM_SPLIT else input_comm
+// MPI standard guarantees opaque types comparable and assignable
+static inline MPI_Comm GetCorrectComm(const MPI_Comm input_comm) {
+  MPI_Comm correct_comm;
+  if(input_comm == MPI_COMM_WORLD) {
+    if(split_deferred)
+      CreateDeferredSplit();
+    correct_comm = MPI_COMM_SPLIT;
+  }
+  else
+    correct_comm = input_comm;
+
+  return correct_comm;
+}
+
+// Fortran binding counterpart of GetCorrectComm
+static inline MPI_Fint GetCorrectFortranComm(const MPI_Fint input_comm) {
+  MPI_Fint correct_comm;
+  if(input_comm == fortran_comm_world) {
+    if(split_deferred)
+      CreateDeferredSplit();
+    correct_comm = fortran_comm_split;
+  }
+  else
+    correct_comm = input_comm;
+
+  return correct_comm;
+}
+
+#endif
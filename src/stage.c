@@ -0,0 +1,175 @@
+/*
+  W_STAGE_OUTERR names a node-local directory, such as /dev/shm or /tmp, in
+  which the redirected stdout and stderr files of the rank are written instead
+  of beside the color's output name on the shared filesystem. MPI_Finalize,
+  which the W_IGNORE_SEGV/W_IGNORE_ABRT signal handlers and W_IGNORE_RETURN_CODE
+  exit handler call, appends each staged file to the color's file in writes of
+  STAGE_BUFFER_SIZE bytes and removes it.
+
+  The ranks, or with W_FORWARD_OUTERR the aggregators, of a color each stage
+  their own files, holding an fcntl lock on the color's file while copying, so
+  the color's files hold the output of each in turn rather than interleaved. A file W_LAZY_OUTERR never created is not staged
+  out, so the color's file is not created either. Output of a rank killed
+  before MPI_Finalize stays in the staging directory. Ranks set up by
+  MPI_Session_init may never call MPI_Finalize, so StageInit isn't called for
+  them and their files are written directly.
+*/
+
+#define _GNU_SOURCE // asprintf
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+#define STAGE_BUFFER_SIZE (4 << 20)
+#define MAX_STAGED_FILES 2
+
+typedef struct {
+  char *staged;
+  char *final;
+} StagedFile;
+
+static StagedFile staged_files[MAX_STAGED_FILES];
+static int staged_count = 0;
+
+// W_STAGE_OUTERR, NULL unless StageInit was called
+static const char *stage_dir = NULL;
+
+// The rank's stderr before redirection, for stage out errors
+static int stage_error_fd = -1;
+
+void StageInit() {
+  stage_dir = getenv("W_STAGE_OUTERR");
+  if(!stage_dir)
+    return;
+
+  stage_error_fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+}
+
+void StreamFileName(char *const name, const size_t size, const char *const out_err_filename,
+                    const char *const suffix) {
+  if(!stage_dir || staged_count == MAX_STAGED_FILES) {
+    snprintf(name, size, "%s.%s", out_err_filename, suffix);
+    return;
+  }
+
+  // The application may change directory before MPI_Finalize
+  StagedFile *const file = &staged_files[staged_count];
+  char cwd[2048];
+  int length;
+  if(out_err_filename[0] == '/')
+    length = asprintf(&file->final, "%s.%s", out_err_filename, suffix);
+  else if(getcwd(cwd, sizeof(cwd)))
+    length = asprintf(&file->final, "%s/%s.%s", cwd, out_err_filename, suffix);
+  else
+    EXIT_PRINT("Error getting working directory: %s\n", strerror(errno));
+  if(length < 0)
+    EXIT_PRINT("Error allocating staged file name!\n");
+
+  if(asprintf(&file->staged, "%s/wraprun.%d.%s", stage_dir, (int)getpid(), suffix) < 0)
+    EXIT_PRINT("Error allocating staged file name!\n");
+  staged_count++;
+
+  snprintf(name, size, "%s", file->staged);
+}
+
+// Append staged to final in large writes, returns 0 on success
+static int CopyStagedFile(const StagedFile *const file, char *const buffer) {
+  const int in = open(file->staged, O_RDONLY | O_CLOEXEC);
+  if(in < 0 && errno == ENOENT)
+    return -1;
+  if(in < 0) {
+    dprintf(stage_error_fd, "ERROR OPENING STAGED FILE %s: %s\n", file->staged, strerror(errno));
+    return -1;
+  }
+  const int out = open(file->final, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+  if(out < 0) {
+    dprintf(stage_error_fd, "ERROR OPENING FILE %s: %s\n", file->final, strerror(errno));
+    close(in);
+    return -1;
+  }
+
+  // The writes of other ranks staging out to the file wait on the lock, so
+  // each rank's output is kept together
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  while(fcntl(out, F_SETLKW, &lock) < 0) {
+    if(errno == EINTR)
+      continue;
+    dprintf(stage_error_fd, "ERROR LOCKING FILE %s: %s\n", file->final, strerror(errno));
+    close(in);
+    close(out);
+    return -1;
+  }
+
+  int err = 0;
+  ssize_t count;
+  while(!err && (count = read(in, buffer, STAGE_BUFFER_SIZE)) != 0) {
+    if(count < 0 && errno == EINTR)
+      continue;
+    if(count < 0) {
+      err = errno;
+      break;
+    }
+
+    ssize_t written = 0;
+    while(written < count) {
+      const ssize_t done = write(out, buffer + written, count - written);
+      if(done < 0 && errno == EINTR)
+        continue;
+      if(done < 0) {
+        err = errno;
+        break;
+      }
+      written += done;
+    }
+  }
+
+  // Closing the file releases the lock
+  close(in);
+  close(out);
+  if(err) {
+    dprintf(stage_error_fd, "ERROR STAGING OUT FILE %s: %s\n", file->final, strerror(err));
+    return -1;
+  }
+  return 0;
+}
+
+// Append the staged files, once closed, to the color's files, removing those
+// copied
+static void CopyStagedFiles() {
+  char *const buffer = malloc(STAGE_BUFFER_SIZE);
+  if(!buffer) {
+    dprintf(stage_error_fd, "ERROR ALLOCATING STAGE OUT MEMORY!\n");
+    return;
+  }
+
+  int i;
+  for(i=0; i<staged_count; i++) {
+    if(CopyStagedFile(&staged_files[i], buffer) == 0)
+      unlink(staged_files[i].staged);
+    free(staged_files[i].staged);
+    free(staged_files[i].final);
+  }
+  staged_count = 0;
+
+  free(buffer);
+}
+
+void StageOut() {
+  if(staged_count > 0)
+    CopyStagedFiles();
+
+  // Opened by StageInit even on ranks with no files to stage, such as those
+  // forwarding to another rank's aggregator
+  if(stage_error_fd >= 0)
+    close(stage_error_fd);
+  stage_error_fd = -1;
+}
@@ -0,0 +1,209 @@
+/*
+  W_TIMELINE records when each rank's task starts, at the end of SplitInit(),
+  and ends, on entry to MPI_Finalize before any of its collectives, along with the rank's node and the number
+  of cores it may run on. MPI_Finalize gathers the records over MPI_COMM_WORLD
+  and world rank 0 writes the W_TIMELINE file: the span and nodes of each task,
+  the straggling task, and the core-hours each node sat idle waiting on the
+  last task to finish.
+
+  Times are wall clock so ranks on different nodes share a time base, and are
+  reported in seconds from the first task start.
+*/
+
+#define _GNU_SOURCE // sched_getaffinity
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+#define HOST_NAME_SIZE 64
+
+// One rank's span, gathered to world rank 0 as bytes
+typedef struct {
+  double start;
+  double end;
+  int color;
+  int cores;
+  char host[HOST_NAME_SIZE];
+} TaskSpan;
+
+static TaskSpan rank_span;
+static int timeline_enabled = 0;
+
+static double WallTime() {
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + 1.0e-6*time.tv_usec;
+}
+
+void TimelineStart(const int color) {
+  if(!getenv("W_TIMELINE"))
+    return;
+
+  timeline_enabled = 1;
+  rank_span.start = WallTime();
+  rank_span.color = color;
+
+  cpu_set_t cpus;
+  rank_span.cores = sched_getaffinity(0, sizeof(cpus), &cpus) == 0 ? CPU_COUNT(&cpus) : 1;
+
+  if(gethostname(rank_span.host, HOST_NAME_SIZE))
+    snprintf(rank_span.host, HOST_NAME_SIZE, "unknown");
+  rank_span.host[HOST_NAME_SIZE-1] = '\0';
+}
+
+static int CompareColorHost(const void *a, const void *b) {
+  const TaskSpan *const x = a;
+  const TaskSpan *const y = b;
+  if(x->color != y->color)
+    return (x->color > y->color) - (x->color < y->color);
+  return strcmp(x->host, y->host);
+}
+
+static int CompareHost(const void *a, const void *b) {
+  return strcmp(((const TaskSpan*)a)->host, ((const TaskSpan*)b)->host);
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+  const double x = *(const double*)a;
+  const double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+void TimelineEnd() {
+  if(timeline_enabled && rank_span.end == 0.0)
+    rank_span.end = WallTime();
+}
+
+// Write a line per task and the straggling task, spans sorted by color and host
+static void WriteTasks(FILE *const file, TaskSpan *const spans, const int count,
+                       const double origin) {
+  qsort(spans, count, sizeof(TaskSpan), CompareColorHost);
+
+  double *const task_ends = malloc(count * sizeof(double));
+  if(!task_ends)
+    EXIT_PRINT("Error allocating timeline memory!\n");
+
+  fprintf(file, "%-8s %8s %12s %12s %12s  %s\n", "color", "ranks", "start (s)", "end (s)",
+          "duration (s)", "nodes");
+
+  int tasks = 0;
+  int straggler = 0;
+  double last_end = 0.0;
+  int first, i;
+  for(first=0; first<count; first=i) {
+    double start = spans[first].start;
+    double end = spans[first].end;
+    for(i=first; i<count && spans[i].color == spans[first].color; i++) {
+      if(spans[i].start < start)
+        start = spans[i].start;
+      if(spans[i].end > end)
+        end = spans[i].end;
+    }
+
+    fprintf(file, "%-8d %8d %12.3f %12.3f %12.3f  ", spans[first].color, i - first,
+            start - origin, end - origin, end - start);
+    int j;
+    for(j=first; j<i; j++) {
+      if(j == first || strcmp(spans[j].host, spans[j-1].host))
+        fprintf(file, "%s%s", j == first ? "" : ",", spans[j].host);
+    }
+    fprintf(file, "\n");
+
+    if(tasks == 0 || end > last_end) {
+      straggler = spans[first].color;
+      last_end = end;
+    }
+    task_ends[tasks++] = end;
+  }
+
+  qsort(task_ends, tasks, sizeof(double), CompareDoubles);
+  const double median_end = task_ends[tasks/2];
+  fprintf(file, "# straggler: color %d ended at %.3f s, %.3f s after the median task\n",
+          straggler, last_end - origin, last_end - median_end);
+
+  free(task_ends);
+}
+
+// Write the core-hours each node sat idle between its ranks ending and the
+// last task ending, spans sorted by host
+static void WriteIdleNodes(FILE *const file, TaskSpan *const spans, const int count,
+                           const double last_end) {
+  qsort(spans, count, sizeof(TaskSpan), CompareHost);
+
+  fprintf(file, "%-24s %8s %8s %16s\n", "node", "ranks", "cores", "idle core-hours");
+
+  double total_idle = 0.0;
+  int first, i;
+  for(first=0; first<count; first=i) {
+    int cores = 0;
+    double idle = 0.0;
+    for(i=first; i<count && strcmp(spans[i].host, spans[first].host) == 0; i++) {
+      cores += spans[i].cores;
+      idle += spans[i].cores * (last_end - spans[i].end) / 3600.0;
+    }
+    fprintf(file, "%-24s %8d %8d %16.4f\n", spans[first].host, i - first, cores, idle);
+    total_idle += idle;
+  }
+
+  fprintf(file, "# total idle core-hours: %.4f\n", total_idle);
+}
+
+// Gather every rank's span over MPI_COMM_WORLD, world rank 0 writes the report
+void ReportTimeline() {
+  if(!timeline_enabled)
+    return;
+  TimelineEnd();
+  timeline_enabled = 0;
+
+  int rank, size;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  PMPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  TaskSpan *spans = NULL;
+  if(rank == 0) {
+    spans = malloc(size * sizeof(TaskSpan));
+    if(!spans)
+      EXIT_PRINT("Error allocating timeline memory!\n");
+  }
+
+  const int err = PMPI_Gather(&rank_span, sizeof(TaskSpan), MPI_BYTE, spans, sizeof(TaskSpan),
+                              MPI_BYTE, 0, MPI_COMM_WORLD);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to gather task timeline: %d!\n", err);
+
+  if(rank != 0)
+    return;
+
+  const char *const file_name = getenv("W_TIMELINE");
+  FILE *const file = fopen(file_name, "w");
+  if(!file) {
+    fprintf(stderr, "ERROR OPENING TIMELINE FILE %s: %s\n", file_name, strerror(errno));
+    free(spans);
+    return;
+  }
+
+  double origin = spans[0].start;
+  double last_end = spans[0].end;
+  int i;
+  for(i=1; i<size; i++) {
+    if(spans[i].start < origin)
+      origin = spans[i].start;
+    if(spans[i].end > last_end)
+      last_end = spans[i].end;
+  }
+
+  fprintf(file, "# wraprun timeline over %d ranks, %.3f s from the first task start to the "
+                "last task end\n", size, last_end - origin);
+  WriteTasks(file, spans, size, origin);
+  WriteIdleNodes(file, spans, size, last_end);
+
+  fclose(file);
+  free(spans);
+}
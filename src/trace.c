@@ -0,0 +1,152 @@
+/*
+  W_TRACE keeps the last W_TRACE_EVENTS wrapped MPI calls of each rank in a
+  fixed size ring buffer, and writes them as a Chrome trace, viewable with
+  Perfetto or chrome://tracing, at MPI_Finalize or when the rank receives
+  SIGUSR2.
+
+  Each rank writes <W_TRACE>.<world rank>.json in the JSON array format, with
+  the rank as a thread of a process per color so ranks are grouped by task. The
+  files of several ranks merge into one trace with jq -s add.
+
+  Writing the trace uses stdio, which is not async-signal-safe, so the SIGUSR2
+  handler only posts a semaphore that a writer thread waits on. The thread
+  writes the trace even if the rank is hung inside an MPI call.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/time.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+#define DEFAULT_TRACE_EVENTS 65536
+
+typedef struct {
+  double start;
+  double end;
+  uint64_t bytes;
+  int routine;
+} TraceEvent;
+
+static TraceEvent *trace_events = NULL;
+static uint64_t trace_capacity = 0;
+static uint64_t trace_next = 0;
+
+static int trace_rank = 0;
+static int trace_color = 0;
+
+// Now() is monotonic per node, offset to wall clock so ranks on different
+// nodes share a time base
+static double trace_clock_offset = 0.0;
+
+static pthread_mutex_t trace_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static sem_t trace_requested;
+
+void TraceCall(const int routine, const double start, const double end, const uint64_t bytes) {
+  const uint64_t slot = __atomic_fetch_add(&trace_next, 1, __ATOMIC_RELAXED) % trace_capacity;
+  TraceEvent *const event = &trace_events[slot];
+  event->start = start;
+  event->end = end;
+  event->bytes = bytes;
+  event->routine = routine;
+}
+
+// Write the buffered events, oldest first
+static void WriteTrace() {
+  pthread_mutex_lock(&trace_write_mutex);
+  char file_name[2048];
+  snprintf(file_name, sizeof(file_name), "%s.%d.json", getenv("W_TRACE"), trace_rank);
+  FILE *const file = fopen(file_name, "w");
+  if(!file) {
+    fprintf(stderr, "ERROR OPENING TRACE FILE %s: %s\n", file_name, strerror(errno));
+    pthread_mutex_unlock(&trace_write_mutex);
+    return;
+  }
+
+  fprintf(file, "[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"color %d\"}},\n", trace_color, trace_color);
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"rank %d\"}}", trace_color, trace_rank, trace_rank);
+
+  const uint64_t next = __atomic_load_n(&trace_next, __ATOMIC_RELAXED);
+  const uint64_t first = next > trace_capacity ? next - trace_capacity : 0;
+  uint64_t i;
+  for(i=first; i<next; i++) {
+    const TraceEvent *const event = &trace_events[i % trace_capacity];
+    fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"mpi\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                  "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}}",
+            split_routine_names[event->routine], trace_color, trace_rank,
+            1.0e6*(event->start + trace_clock_offset), 1.0e6*(event->end - event->start),
+            (unsigned long long)event->bytes);
+  }
+  fprintf(file, "\n]\n");
+
+  fclose(file);
+  pthread_mutex_unlock(&trace_write_mutex);
+}
+
+// sem_post is async-signal-safe, unlike writing the trace
+static void TraceSignalHandler(int sig) {
+  sem_post(&trace_requested);
+}
+
+// Write the trace each time SIGUSR2 is received
+static void *TraceWriter(void *arg) {
+  for(;;) {
+    while(sem_wait(&trace_requested) != 0 && errno == EINTR)
+      ;
+    WriteTrace();
+  }
+  return NULL;
+}
+
+void TraceInit(const int color) {
+  if(!getenv("W_TRACE"))
+    return;
+
+  trace_capacity = getenv("W_TRACE_EVENTS") ? strtoull(getenv("W_TRACE_EVENTS"), NULL, 10)
+                                            : DEFAULT_TRACE_EVENTS;
+  if(trace_capacity == 0)
+    EXIT_PRINT("W_TRACE_EVENTS must be a positive number of events\n");
+  trace_events = calloc(trace_capacity, sizeof(TraceEvent));
+  if(!trace_events)
+    EXIT_PRINT("Error allocating trace memory!\n");
+
+  PMPI_Comm_rank(MPI_COMM_WORLD, &trace_rank);
+  trace_color = color;
+
+  struct timeval wall;
+  gettimeofday(&wall, NULL);
+  trace_clock_offset = wall.tv_sec + 1.0e-6*wall.tv_usec - Now();
+
+  pthread_t writer;
+  int err = sem_init(&trace_requested, 0, 0);
+  if(!err)
+    err = pthread_create(&writer, NULL, TraceWriter, NULL);
+  if(err)
+    fprintf(stderr, "ERROR STARTING TRACE WRITER THREAD!\n");
+  else {
+    pthread_detach(writer);
+    if(signal(SIGUSR2, TraceSignalHandler) == SIG_ERR)
+      fprintf(stderr, "ERROR REGISTERING SIGUSR2 HANDLER!\n");
+  }
+
+  split_instrument |= INSTRUMENT_TRACE;
+}
+
+void ReportTrace() {
+  if(!(split_instrument & INSTRUMENT_TRACE))
+    return;
+  split_instrument &= ~INSTRUMENT_TRACE;
+
+  // Other threads may still be recording, so the buffer is never freed
+  WriteTrace();
+}
@@ -0,0 +1,178 @@
+/*
+  W_RUSAGE records the resource usage of each rank at MPI_Finalize, from
+  getrusage() and /proc/self/status, reduces it over the rank's color and has
+  world rank 0 write a line per task to the W_RUSAGE CSV file. Each measure is
+  given as its sum and max over the task's ranks, and its imbalance, the max
+  over the mean, so memory heavy or unbalanced tasks stand out.
+
+  Only the leader, color rank 0, of each task sends its totals to world rank
+  0, which learns how many to receive from a reduction of one int, so world
+  rank 0 receives a record per task rather than per rank.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "mpi.h"
+#include "split.h"
+#include "print_macros.h"
+
+enum { USAGE_USER, USAGE_SYS, USAGE_MAX_RSS, USAGE_PEAK_VM, USAGE_MINOR_FAULTS,
+       USAGE_MAJOR_FAULTS, USAGE_VOLUNTARY_SWITCHES, USAGE_INVOLUNTARY_SWITCHES, USAGE_COUNT };
+static const char *const USAGE_NAMES[USAGE_COUNT] = {
+  "user_s", "sys_s", "max_rss_kb", "peak_vm_kb", "minor_faults", "major_faults",
+  "voluntary_switches", "involuntary_switches"};
+
+#define USAGE_TAG 4242
+
+// A task's usage sent from its color rank 0 to world rank 0
+typedef struct {
+  int color;
+  int ranks;
+  double sums[USAGE_COUNT];
+  double maxs[USAGE_COUNT];
+} TaskUsage;
+
+static int usage_enabled = 0;
+static int usage_color = 0;
+
+void UsageInit(const int color) {
+  if(!getenv("W_RUSAGE"))
+    return;
+
+  usage_enabled = 1;
+  usage_color = color;
+}
+
+// Value in kB of a "Name:   value kB" line of /proc/self/status, or -1
+static double ProcStatusKB(const char *const status, const char *const name) {
+  const char *const line = strstr(status, name);
+  if(!line)
+    return -1.0;
+  return strtod(line + strlen(name), NULL);
+}
+
+static void GetRankUsage(double *const usage) {
+  struct rusage rank_usage;
+  getrusage(RUSAGE_SELF, &rank_usage);
+  usage[USAGE_USER] = rank_usage.ru_utime.tv_sec + 1.0e-6*rank_usage.ru_utime.tv_usec;
+  usage[USAGE_SYS] = rank_usage.ru_stime.tv_sec + 1.0e-6*rank_usage.ru_stime.tv_usec;
+  usage[USAGE_MAX_RSS] = rank_usage.ru_maxrss;
+  usage[USAGE_PEAK_VM] = 0.0;
+  usage[USAGE_MINOR_FAULTS] = rank_usage.ru_minflt;
+  usage[USAGE_MAJOR_FAULTS] = rank_usage.ru_majflt;
+  usage[USAGE_VOLUNTARY_SWITCHES] = rank_usage.ru_nvcsw;
+  usage[USAGE_INVOLUNTARY_SWITCHES] = rank_usage.ru_nivcsw;
+
+  // The high water marks of resident and virtual memory
+  FILE *const file = fopen("/proc/self/status", "r");
+  if(!file)
+    return;
+  char status[8192];
+  const size_t length = fread(status, 1, sizeof(status) - 1, file);
+  status[length] = '\0';
+  fclose(file);
+
+  const double max_rss = ProcStatusKB(status, "VmHWM:");
+  if(max_rss >= 0.0)
+    usage[USAGE_MAX_RSS] = max_rss;
+  const double peak_vm = ProcStatusKB(status, "VmPeak:");
+  if(peak_vm >= 0.0)
+    usage[USAGE_PEAK_VM] = peak_vm;
+}
+
+static void WriteUsage(const TaskUsage *const tasks, const int count) {
+  const char *const file_name = getenv("W_RUSAGE");
+  FILE *const file = fopen(file_name, "w");
+  if(!file) {
+    fprintf(stderr, "ERROR OPENING RUSAGE FILE %s: %s\n", file_name, strerror(errno));
+    return;
+  }
+
+  int i, j;
+  fprintf(file, "color,ranks");
+  for(j=0; j<USAGE_COUNT; j++)
+    fprintf(file, ",%s_sum,%s_max,%s_imbalance", USAGE_NAMES[j], USAGE_NAMES[j], USAGE_NAMES[j]);
+  fprintf(file, "\n");
+
+  for(i=0; i<count; i++) {
+    const TaskUsage *const task = &tasks[i];
+    fprintf(file, "%d,%d", task->color, task->ranks);
+    for(j=0; j<USAGE_COUNT; j++) {
+      const double mean = task->sums[j] / task->ranks;
+      fprintf(file, ",%.6g,%.6g,%.3f", task->sums[j], task->maxs[j],
+              mean > 0.0 ? task->maxs[j] / mean : 1.0);
+    }
+    fprintf(file, "\n");
+  }
+
+  fclose(file);
+}
+
+static int CompareTaskColors(const void *a, const void *b) {
+  return ((const TaskUsage*)a)->color - ((const TaskUsage*)b)->color;
+}
+
+// Reduce the ranks' usage over comm, the rank's color, and send each color's
+// totals from its leader, color rank 0, to world rank 0 which writes W_RUSAGE
+void ReportUsage(const MPI_Comm comm) {
+  if(!usage_enabled)
+    return;
+  usage_enabled = 0;
+
+  double usage[USAGE_COUNT];
+  GetRankUsage(usage);
+
+  TaskUsage task;
+  memset(&task, 0, sizeof(task));
+  task.color = usage_color;
+
+  int color_rank, color_size;
+  PMPI_Comm_rank(comm, &color_rank);
+  PMPI_Comm_size(comm, &color_size);
+  PMPI_Reduce(usage, task.sums, USAGE_COUNT, MPI_DOUBLE, MPI_SUM, 0, comm);
+  PMPI_Reduce(usage, task.maxs, USAGE_COUNT, MPI_DOUBLE, MPI_MAX, 0, comm);
+  task.ranks = color_size;
+
+  // World rank 0 only learns how many leaders will send
+  const int leader = color_rank == 0;
+  int leader_count = 0;
+  int world_rank;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  int err = PMPI_Reduce(&leader, &leader_count, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+  if(err != MPI_SUCCESS)
+    EXIT_PRINT("Failed to count task leaders: %d!\n", err);
+
+  // The application's MPI_COMM_WORLD is MPI_COMM_SPLIT, so no message of its
+  // can match these
+  if(world_rank != 0) {
+    if(leader) {
+      err = PMPI_Send(&task, sizeof(TaskUsage), MPI_BYTE, 0, USAGE_TAG, MPI_COMM_WORLD);
+      if(err != MPI_SUCCESS)
+        EXIT_PRINT("Failed to send task usage: %d!\n", err);
+    }
+    return;
+  }
+
+  TaskUsage *const tasks = malloc(leader_count * sizeof(TaskUsage));
+  if(!tasks)
+    EXIT_PRINT("Error allocating rusage memory!\n");
+
+  int i = 0;
+  if(leader)
+    tasks[i++] = task;
+  for(; i<leader_count; i++) {
+    err = PMPI_Recv(&tasks[i], sizeof(TaskUsage), MPI_BYTE, MPI_ANY_SOURCE, USAGE_TAG,
+                    MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if(err != MPI_SUCCESS)
+      EXIT_PRINT("Failed to receive task usage: %d!\n", err);
+  }
+
+  qsort(tasks, leader_count, sizeof(TaskUsage), CompareTaskColors);
+  WriteUsage(tasks, leader_count);
+
+  free(tasks);
+}
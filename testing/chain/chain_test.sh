@@ -0,0 +1,50 @@
+#!/bin/bash
+# Stacks count_tool after libsplit with W_PMPI_CHAIN set and checks the tool
+# sees each of helloMPI's MPI calls once, none of them on MPI_COMM_WORLD, while
+# the ranks are still split into two tasks.
+#
+# usage: chain_test.sh [build_dir] [ranks]
+# MPIRUN may be set to the launcher, "mpirun" by default, with any extra
+# arguments it needs, e.g. MPIRUN="mpirun --oversubscribe"
+
+BUILD_DIR=$(cd ${1:-build} && pwd)
+RANKS=${2:-4}
+MPIRUN=${MPIRUN:-mpirun}
+MPICC=${MPICC:-mpicc}
+TEST_DIR=$(cd $(dirname $0) && pwd)
+
+LIBSPLIT=$BUILD_DIR/libsplit.so
+if [ ! -f $LIBSPLIT ]; then
+  echo "libsplit.so not found in $BUILD_DIR, build it first" >&2
+  exit 1
+fi
+
+WORK_DIR=$(mktemp -d)
+trap "rm -rf $WORK_DIR" EXIT
+
+$MPICC -shared -fPIC $TEST_DIR/count_tool.c -o $WORK_DIR/libcount_tool.so || exit 1
+$MPICC $TEST_DIR/../helloMPI.c -o $WORK_DIR/hello || exit 1
+
+# Two tasks of half the ranks each
+for i in $(seq 1 $RANKS); do
+  echo "$(( 2 * (i - 1) / RANKS )) $WORK_DIR hello" >> $WORK_DIR/params
+done
+
+PRELOAD=$LIBSPLIT:$WORK_DIR/libcount_tool.so
+if $MPIRUN --version 2>&1 | grep -q "Open MPI\|OpenRTE"; then
+  PRELOAD_ENV="-x LD_PRELOAD=$PRELOAD -x WRAPRUN_FILE=$WORK_DIR/params -x W_PMPI_CHAIN=1"
+else
+  PRELOAD_ENV="-genv LD_PRELOAD $PRELOAD -genv WRAPRUN_FILE $WORK_DIR/params -genv W_PMPI_CHAIN 1"
+fi
+
+$MPIRUN -np $RANKS $PRELOAD_ENV $WORK_DIR/hello > $WORK_DIR/out || exit 1
+cat $WORK_DIR/out
+
+EXPECTED="init 1 comm_rank 1 comm_size 1 barrier 1 world 0"
+COUNTED=$(grep -c "count_tool: .* $EXPECTED$" $WORK_DIR/out)
+SPLIT=$(grep -c "of $(( RANKS / 2 )) working" $WORK_DIR/out)
+if [ "$COUNTED" -ne "$RANKS" ] || [ "$SPLIT" -ne "$RANKS" ]; then
+  echo "FAILED: expected every rank to report '$EXPECTED' in a task of $(( RANKS / 2 ))"
+  exit 1
+fi
+echo "passed"
@@ -0,0 +1,50 @@
+/*
+  A minimal PMPI tool used to check W_PMPI_CHAIN: it counts the MPI_Comm_rank,
+  MPI_Comm_size and MPI_Barrier calls it sees, and how many of those were made
+  on MPI_COMM_WORLD, and prints the counts from MPI_Finalize.
+
+  Stacked after libsplit each call should be counted once, on the task's
+  communicator rather than MPI_COMM_WORLD. chain_test.sh builds and runs it:
+    mpicc -shared -fPIC count_tool.c -o libcount_tool.so
+    LD_PRELOAD=libsplit.so:libcount_tool.so W_PMPI_CHAIN=1 mpirun ...
+*/
+
+#include <stdio.h>
+#include <mpi.h>
+
+static int init_calls = 0;
+static int rank_calls = 0;
+static int size_calls = 0;
+static int barrier_calls = 0;
+static int world_calls = 0;
+
+int MPI_Init(int *argc, char ***argv) {
+  init_calls++;
+  return PMPI_Init(argc, argv);
+}
+
+int MPI_Comm_rank(MPI_Comm comm, int *rank) {
+  rank_calls++;
+  world_calls += comm == MPI_COMM_WORLD;
+  return PMPI_Comm_rank(comm, rank);
+}
+
+int MPI_Comm_size(MPI_Comm comm, int *size) {
+  size_calls++;
+  world_calls += comm == MPI_COMM_WORLD;
+  return PMPI_Comm_size(comm, size);
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+  barrier_calls++;
+  world_calls += comm == MPI_COMM_WORLD;
+  return PMPI_Barrier(comm);
+}
+
+int MPI_Finalize() {
+  int world_rank;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  printf("count_tool: world rank %d init %d comm_rank %d comm_size %d barrier %d world %d\n",
+         world_rank, init_calls, rank_calls, size_calls, barrier_calls, world_calls);
+  return PMPI_Finalize();
+}
@@ -0,0 +1,84 @@
+/*
+  Checks that MPI-4 large count (_c) calls made on MPI_COMM_WORLD stay within
+  the calling rank's wraprun task.
+
+  PMPI_Comm_rank bypasses libsplit and gives the true world rank, the task's
+  ranks are contiguous so its first world rank is the true rank less the
+  translated rank. MPI_Allreduce_c, MPI_Bcast_c and a ring of
+  MPI_Isend_c/MPI_Recv_c must only ever see world ranks of the same task.
+
+  Build against an MPI-4 library and run as several tasks, a message size
+  above INT_MAX bytes exercises counts that overflow an int. Each rank holds
+  a send and a receive buffer of that size, so run a rank per node:
+    cc large_count.c -o large_count
+    wraprun -n 2 -N 1 ./large_count 2147483649 : -n 2 -N 1 ./large_count 2147483649
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#if MPI_VERSION < 4
+#error "MPI-4 large count routines required"
+#endif
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size, world_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+  const MPI_Count bytes = argc > 1 ? strtoll(argv[1], NULL, 10) : 1 << 20;
+  const int first_rank = world_rank - rank;
+  int failures = 0;
+
+  int min_rank, max_rank;
+  MPI_Allreduce_c(&world_rank, &min_rank, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce_c(&world_rank, &max_rank, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if(min_rank != first_rank || max_rank != first_rank + size - 1) {
+    printf("rank %d: MPI_Allreduce_c spans world ranks %d-%d\n", world_rank, min_rank, max_rank);
+    failures++;
+  }
+
+  int root_rank = world_rank;
+  MPI_Bcast_c(&root_rank, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if(root_rank != first_rank) {
+    printf("rank %d: MPI_Bcast_c root is world rank %d\n", world_rank, root_rank);
+    failures++;
+  }
+
+  // Pass a message of bytes filled with the sender's world rank around the task
+  char *const send_buffer = malloc(bytes);
+  char *const recv_buffer = malloc(bytes);
+  if(!send_buffer || !recv_buffer) {
+    printf("rank %d: can't allocate %lld bytes\n", world_rank, (long long)bytes);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  memset(send_buffer, world_rank % 128, bytes);
+  memset(recv_buffer, -1, bytes);
+
+  MPI_Request request;
+  MPI_Isend_c(send_buffer, bytes, MPI_BYTE, (rank + 1) % size, 0, MPI_COMM_WORLD, &request);
+  MPI_Recv_c(recv_buffer, bytes, MPI_BYTE, (rank + size - 1) % size, 0, MPI_COMM_WORLD,
+             MPI_STATUS_IGNORE);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+  const char expected = (first_rank + (rank + size - 1) % size) % 128;
+  if(recv_buffer[0] != expected || recv_buffer[bytes-1] != expected) {
+    printf("rank %d: MPI_Recv_c got data from world rank %d\n", world_rank, recv_buffer[0]);
+    failures++;
+  }
+
+  free(recv_buffer);
+  free(send_buffer);
+
+  printf("rank %d of %d (world rank %d): large count %s\n", rank, size, world_rank,
+         failures ? "FAILED" : "passed");
+
+  MPI_Finalize();
+
+  return failures != 0;
+}
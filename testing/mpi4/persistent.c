@@ -0,0 +1,113 @@
+/*
+  Checks that MPI-4 persistent collectives and partitioned point to point
+  requests created on MPI_COMM_WORLD stay within the calling rank's wraprun
+  task.
+
+  As in large_count.c, PMPI_Comm_rank gives the true world rank and the task's
+  first world rank is the true rank less the translated rank. Each request is
+  started several times to check the translated communicator is kept for the
+  life of the request.
+
+  Build against an MPI-4 library and run as several tasks:
+    cc persistent.c -o persistent
+    wraprun -n 4 ./persistent : -n 4 ./persistent
+*/
+
+#include <stdio.h>
+#include <mpi.h>
+
+#if MPI_VERSION < 4
+#error "MPI-4 persistent collectives and partitioned communication required"
+#endif
+
+#define STARTS 3
+#define PARTITIONS 8
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size, world_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+  const int first_rank = world_rank - rank;
+  const int next = (rank + 1) % size;
+  const int prev = (rank + size - 1) % size;
+  int failures = 0;
+  int start;
+
+  // MPI_Allreduce_init and MPI_Bcast_init directly on MPI_COMM_WORLD
+  int min_rank, root_rank;
+  MPI_Request requests[2];
+  MPI_Allreduce_init(&world_rank, &min_rank, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD,
+                     MPI_INFO_NULL, &requests[0]);
+  MPI_Bcast_init(&root_rank, 1, MPI_INT, 0, MPI_COMM_WORLD, MPI_INFO_NULL, &requests[1]);
+  for(start=0; start<STARTS; start++) {
+    root_rank = world_rank;
+    MPI_Start(&requests[0]);
+    MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+    MPI_Start(&requests[1]);
+    MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
+    if(min_rank != first_rank || root_rank != first_rank) {
+      printf("rank %d: persistent collectives reached world ranks %d and %d\n", world_rank,
+             min_rank, root_rank);
+      failures++;
+    }
+  }
+  MPI_Request_free(&requests[0]);
+  MPI_Request_free(&requests[1]);
+
+  // MPI_Neighbor_alltoall_init over a periodic ring built from MPI_COMM_WORLD
+  MPI_Comm ring;
+  const int periods[1] = {1};
+  MPI_Cart_create(MPI_COMM_WORLD, 1, &size, periods, 0, &ring);
+  int send_ranks[2] = {world_rank, world_rank};
+  int recv_ranks[2];
+  MPI_Neighbor_alltoall_init(send_ranks, 1, MPI_INT, recv_ranks, 1, MPI_INT, ring,
+                             MPI_INFO_NULL, &requests[0]);
+  for(start=0; start<STARTS; start++) {
+    MPI_Start(&requests[0]);
+    MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+    if(recv_ranks[0] != first_rank + prev || recv_ranks[1] != first_rank + next) {
+      printf("rank %d: persistent neighbor alltoall got world ranks %d and %d\n", world_rank,
+             recv_ranks[0], recv_ranks[1]);
+      failures++;
+    }
+  }
+  MPI_Request_free(&requests[0]);
+  MPI_Comm_free(&ring);
+
+  // MPI_Psend_init/MPI_Precv_init around the task, each partition holds the sender's world rank
+  int send_buffer[PARTITIONS];
+  int recv_buffer[PARTITIONS];
+  MPI_Psend_init(send_buffer, PARTITIONS, 1, MPI_INT, next, 0, MPI_COMM_WORLD, MPI_INFO_NULL,
+                 &requests[0]);
+  MPI_Precv_init(recv_buffer, PARTITIONS, 1, MPI_INT, prev, 0, MPI_COMM_WORLD, MPI_INFO_NULL,
+                 &requests[1]);
+  for(start=0; start<STARTS; start++) {
+    int partition;
+    MPI_Startall(2, requests);
+    for(partition=0; partition<PARTITIONS; partition++) {
+      send_buffer[partition] = world_rank;
+      MPI_Pready(partition, requests[0]);
+    }
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    for(partition=0; partition<PARTITIONS; partition++) {
+      if(recv_buffer[partition] != first_rank + prev) {
+        printf("rank %d: partition %d came from world rank %d\n", world_rank, partition,
+               recv_buffer[partition]);
+        failures++;
+      }
+    }
+  }
+  MPI_Request_free(&requests[0]);
+  MPI_Request_free(&requests[1]);
+
+  printf("rank %d of %d (world rank %d): persistent %s\n", rank, size, world_rank,
+         failures ? "FAILED" : "passed");
+
+  MPI_Finalize();
+
+  return failures != 0;
+}
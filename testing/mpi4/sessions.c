@@ -0,0 +1,93 @@
+/*
+  Checks that an MPI Sessions application, which never calls MPI_Init, builds
+  its communicator from the calling rank's wraprun task.
+
+  PMPI_Group_from_session_pset bypasses libsplit and gives the true mpi://WORLD
+  group and so the true world rank. A communicator created from the mpi://WORLD
+  process set must only span the world ranks of the rank's task, match the
+  mpi_size of the wraprun://color process set, and wraprun://color must be
+  listed among the session's process sets.
+
+  Build against an MPI-4 library and run as several tasks:
+    cc sessions.c -o sessions
+    wraprun -n 4 ./sessions : -n 4 ./sessions
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+#if MPI_VERSION < 4
+#error "MPI-4 sessions required"
+#endif
+
+int main(int argc, char *argv[]) {
+  MPI_Session session;
+  MPI_Session_init(MPI_INFO_NULL, MPI_ERRORS_ARE_FATAL, &session);
+
+  MPI_Group true_world, group;
+  int world_rank;
+  PMPI_Group_from_session_pset(session, "mpi://WORLD", &true_world);
+  PMPI_Group_rank(true_world, &world_rank);
+  PMPI_Group_free(&true_world);
+
+  MPI_Comm comm;
+  MPI_Group_from_session_pset(session, "mpi://WORLD", &group);
+  MPI_Comm_create_from_group(group, "wraprun.sessions", MPI_INFO_NULL, MPI_ERRORS_ARE_FATAL,
+                             &comm);
+  MPI_Group_free(&group);
+
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  const int first_rank = world_rank - rank;
+  int failures = 0;
+
+  int min_rank, max_rank;
+  MPI_Allreduce(&world_rank, &min_rank, 1, MPI_INT, MPI_MIN, comm);
+  MPI_Allreduce(&world_rank, &max_rank, 1, MPI_INT, MPI_MAX, comm);
+  if(min_rank != first_rank || max_rank != first_rank + size - 1) {
+    printf("rank %d: mpi://WORLD spans world ranks %d to %d\n", world_rank, min_rank, max_rank);
+    failures++;
+  }
+
+  // wraprun://color is listed and reports the task's size
+  int pset_count, n, listed = 0;
+  MPI_Session_get_num_psets(session, MPI_INFO_NULL, &pset_count);
+  for(n=0; n<pset_count; n++) {
+    char name[MPI_MAX_PSET_NAME_LEN];
+    int length = sizeof(name);
+    MPI_Session_get_nth_pset(session, MPI_INFO_NULL, n, &length, name);
+    listed |= strcmp(name, "wraprun://color") == 0;
+  }
+  if(!listed) {
+    printf("rank %d: wraprun://color not listed\n", world_rank);
+    failures++;
+  }
+
+  MPI_Info info;
+  char value[MPI_MAX_INFO_VAL];
+  char color[MPI_MAX_INFO_VAL] = "";
+  int length = sizeof(value);
+  int flag;
+  MPI_Session_get_pset_info(session, "wraprun://color", &info);
+  MPI_Info_get_string(info, "mpi_size", &length, value, &flag);
+  if(!flag || atoi(value) != size) {
+    printf("rank %d: wraprun://color mpi_size %s, expected %d\n", world_rank,
+           flag ? value : "unset", size);
+    failures++;
+  }
+  length = sizeof(color);
+  MPI_Info_get_string(info, "wraprun_color", &length, color, &flag);
+  MPI_Info_free(&info);
+
+  printf("rank %d of %d (world rank %d, color %s): sessions %s\n", rank, size, world_rank, color,
+         failures ? "FAILED" : "passed");
+
+  MPI_Comm_free(&comm);
+  MPI_Session_finalize(&session);
+
+  return failures != 0;
+}
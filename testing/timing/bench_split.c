@@ -0,0 +1,135 @@
+/*
+  Measures the per call cost of libsplit's interposition on latency bound MPI
+  calls made on MPI_COMM_WORLD: MPI_Comm_rank, MPI_Send/MPI_Recv ping-pong
+  between rank pairs, windows of MPI_Isend/MPI_Irecv completed by MPI_Waitall,
+  a single double MPI_Allreduce and MPI_Barrier.
+
+  Rank 0 prints one "test value unit" line per test, the slowest rank's time
+  per call or the slowest pair's message rate. Run it with and without
+  libsplit preloaded to compare, bench_split.sh does both:
+    testing/timing/bench_split.sh build 4
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+#define WINDOW 64
+
+static double CommRankTime(const int iterations) {
+  int rank;
+  int i;
+  const double start = MPI_Wtime();
+  for(i=0; i<iterations; i++)
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  return (MPI_Wtime() - start) / iterations;
+}
+
+// Half round trip time of a one byte ping-pong with the paired rank
+static double SendRecvTime(const int peer, const int iterations) {
+  char byte = 0;
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if(peer < 0)
+    return 0.0;
+
+  int i;
+  const double start = MPI_Wtime();
+  for(i=0; i<iterations; i++) {
+    if(rank < peer) {
+      MPI_Send(&byte, 1, MPI_CHAR, peer, 0, MPI_COMM_WORLD);
+      MPI_Recv(&byte, 1, MPI_CHAR, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    else {
+      MPI_Recv(&byte, 1, MPI_CHAR, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Send(&byte, 1, MPI_CHAR, peer, 0, MPI_COMM_WORLD);
+    }
+  }
+  return (MPI_Wtime() - start) / (2.0 * iterations);
+}
+
+// Time per message of windows of one byte messages sent to the paired rank
+static double IsendWaitallTime(const int peer, const int iterations) {
+  char bytes[WINDOW];
+  MPI_Request requests[WINDOW];
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if(peer < 0)
+    return 0.0;
+
+  const int windows = iterations / WINDOW > 0 ? iterations / WINDOW : 1;
+  int i, j;
+  const double start = MPI_Wtime();
+  for(i=0; i<windows; i++) {
+    for(j=0; j<WINDOW; j++) {
+      if(rank < peer)
+        MPI_Isend(&bytes[j], 1, MPI_CHAR, peer, j, MPI_COMM_WORLD, &requests[j]);
+      else
+        MPI_Irecv(&bytes[j], 1, MPI_CHAR, peer, j, MPI_COMM_WORLD, &requests[j]);
+    }
+    MPI_Waitall(WINDOW, requests, MPI_STATUSES_IGNORE);
+  }
+  return (MPI_Wtime() - start) / (windows * WINDOW);
+}
+
+static double AllreduceTime(const int iterations) {
+  double value = 1.0;
+  double sum;
+  int i;
+  MPI_Barrier(MPI_COMM_WORLD);
+  const double start = MPI_Wtime();
+  for(i=0; i<iterations; i++)
+    MPI_Allreduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  return (MPI_Wtime() - start) / iterations;
+}
+
+static double BarrierTime(const int iterations) {
+  int i;
+  MPI_Barrier(MPI_COMM_WORLD);
+  const double start = MPI_Wtime();
+  for(i=0; i<iterations; i++)
+    MPI_Barrier(MPI_COMM_WORLD);
+  return (MPI_Wtime() - start) / iterations;
+}
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+
+  // Pair even ranks with the next odd rank, an odd last rank sits out
+  const int peer = (rank ^ 1) < size ? rank ^ 1 : -1;
+
+  // First pass warms up connections and is discarded
+  int pass;
+  double times[5];
+  for(pass=0; pass<2; pass++) {
+    const int count = pass ? iterations : iterations / 10 + 1;
+    times[0] = CommRankTime(count);
+    times[1] = SendRecvTime(peer, count);
+    times[2] = IsendWaitallTime(peer, count);
+    times[3] = AllreduceTime(count);
+    times[4] = BarrierTime(count);
+  }
+
+  double max_times[5];
+  MPI_Reduce(times, max_times, 5, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  if(rank == 0) {
+    printf("%-14s %12.1f ns\n", "comm_rank", max_times[0] * 1.0e9);
+    printf("%-14s %12.3f us\n", "send_recv", max_times[1] * 1.0e6);
+    printf("%-14s %12.0f msg/s\n", "isend_waitall", max_times[2] > 0.0 ? 1.0 / max_times[2] : 0.0);
+    printf("%-14s %12.3f us\n", "allreduce", max_times[3] * 1.0e6);
+    printf("%-14s %12.3f us\n", "barrier", max_times[4] * 1.0e6);
+  }
+
+  MPI_Finalize();
+
+  return 0;
+}
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Runs bench_split without and with libsplit preloaded on the local machine and
+# prints the overhead libsplit adds to each test.
+#
+# usage: bench_split.sh [build_dir] [ranks] [iterations]
+# MPIRUN may be set to the launcher, "mpirun" by default, with any extra
+# arguments it needs, e.g. MPIRUN="mpirun --oversubscribe"
+
+BUILD_DIR=$(cd ${1:-build} && pwd)
+RANKS=${2:-4}
+ITERATIONS=${3:-100000}
+MPIRUN=${MPIRUN:-mpirun}
+
+BENCH=$BUILD_DIR/bench_split
+LIBSPLIT=$BUILD_DIR/libsplit.so
+if [ ! -x $BENCH ] || [ ! -f $LIBSPLIT ]; then
+  echo "bench_split and libsplit.so not found in $BUILD_DIR, build them first" >&2
+  exit 1
+fi
+
+WORK_DIR=$(mktemp -d)
+trap "rm -rf $WORK_DIR" EXIT
+
+# Every rank in one color so MPI_COMM_SPLIT spans the same ranks as MPI_COMM_WORLD
+for i in $(seq 1 $RANKS); do
+  echo "0 $WORK_DIR bench_split" >> $WORK_DIR/params
+done
+
+# Open MPI forwards environment variables with -x, MPICH with -genv
+if $MPIRUN --version 2>&1 | grep -q "Open MPI\|OpenRTE"; then
+  PRELOAD_ENV="-x LD_PRELOAD=$LIBSPLIT -x WRAPRUN_FILE=$WORK_DIR/params"
+else
+  PRELOAD_ENV="-genv LD_PRELOAD $LIBSPLIT -genv WRAPRUN_FILE $WORK_DIR/params"
+fi
+
+$MPIRUN -np $RANKS $BENCH $ITERATIONS > $WORK_DIR/baseline || exit 1
+$MPIRUN -np $RANKS $PRELOAD_ENV $BENCH $ITERATIONS > $WORK_DIR/libsplit || exit 1
+
+echo "Ranks: $RANKS Iterations: $ITERATIONS"
+paste $WORK_DIR/baseline $WORK_DIR/libsplit | awk '
+  BEGIN { printf "%-14s %8s %14s %14s %10s\n", "test", "unit", "baseline", "libsplit", "overhead" }
+  {
+    # Rates are better higher, times lower
+    overhead = $3 == "msg/s" ? ($2 - $5) / $2 : ($5 - $2) / $2
+    printf "%-14s %8s %14s %14s %9.1f%%\n", $1, $3, $2, $5, 100 * overhead
+  }'
@@ -0,0 +1,97 @@
+/*
+  Compares the two ways libsplit can build MPI_COMM_SPLIT as the number of ranks
+  grows: MPI_Comm_split over all ranks, and MPI_Comm_create_group over the
+  contiguous rank range of each color as done with W_SPLIT_GROUP.
+
+  Ranks are divided into colors of ranks_per_color consecutive ranks and, for
+  each power of two rank count up to the world size, the slowest rank's average
+  time to build the color communicator both ways is printed.
+
+  Build and run without libsplit preloaded:
+    cc comm_split_bench.c -o comm_split_bench
+    aprun -n 1024 ./comm_split_bench [ranks_per_color] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+
+static double TimeCommSplit(MPI_Comm comm, int color, int iterations) {
+  double total = 0.0;
+  int i;
+  for(i=0; i<iterations; i++) {
+    MPI_Comm color_comm;
+    MPI_Barrier(comm);
+    const double start = MPI_Wtime();
+    MPI_Comm_split(comm, color, 0, &color_comm);
+    total += MPI_Wtime() - start;
+    MPI_Comm_free(&color_comm);
+  }
+  return total / iterations;
+}
+
+static double TimeCreateGroup(MPI_Comm comm, int first_rank, int rank_count, int iterations) {
+  MPI_Group comm_group;
+  MPI_Comm_group(comm, &comm_group);
+
+  double total = 0.0;
+  int i;
+  for(i=0; i<iterations; i++) {
+    MPI_Group color_group;
+    MPI_Comm color_comm;
+    MPI_Barrier(comm);
+    const double start = MPI_Wtime();
+    int range[1][3] = {{first_rank, first_rank + rank_count - 1, 1}};
+    MPI_Group_range_incl(comm_group, 1, range, &color_group);
+    MPI_Comm_create_group(comm, color_group, 0, &color_comm);
+    total += MPI_Wtime() - start;
+    MPI_Group_free(&color_group);
+    MPI_Comm_free(&color_comm);
+  }
+
+  MPI_Group_free(&comm_group);
+  return total / iterations;
+}
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const int ranks_per_color = argc > 1 ? atoi(argv[1]) : 16;
+  const int iterations = argc > 2 ? atoi(argv[2]) : 10;
+
+  if(rank == 0)
+    printf("%10s %10s %16s %16s\n", "ranks", "colors", "comm_split (s)", "create_group (s)");
+
+  int ranks;
+  for(ranks=ranks_per_color; ranks<=size; ranks*=2) {
+    // Ranks outside of the first ranks sit out this size
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < ranks ? 0 : MPI_UNDEFINED, rank, &comm);
+
+    double times[2] = {0.0, 0.0};
+    if(comm != MPI_COMM_NULL) {
+      const int color = rank / ranks_per_color;
+      const int first_rank = color * ranks_per_color;
+      const int rank_count = first_rank + ranks_per_color <= ranks ? ranks_per_color
+                                                                   : ranks - first_rank;
+
+      times[0] = TimeCommSplit(comm, color, iterations);
+      times[1] = TimeCreateGroup(comm, first_rank, rank_count, iterations);
+      MPI_Comm_free(&comm);
+    }
+
+    double max_times[2];
+    MPI_Reduce(times, max_times, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if(rank == 0)
+      printf("%10d %10d %16.6f %16.6f\n", ranks, (ranks + ranks_per_color - 1) / ranks_per_color,
+             max_times[0], max_times[1]);
+  }
+
+  MPI_Finalize();
+
+  return 0;
+}
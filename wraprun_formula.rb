@@ -138,20 +138,7 @@ class WraprunFormula < Formula
 		prepend-path PYTHONPATH      $PREFIX/lib/$LIBDIR/site-packages
 		prepend-path MANPATH         $PREFIX/share/man/man1
 
-    # The libfmpich library is suffixed with the PE name, so we must extract it
-    set compiler $env(PE_ENV)
-    set compiler [string tolower $compiler]
-
-    set libmpichf $env(MPICH_DIR)/lib/libfmpich_$compiler.so
-    if { [file exists $libmpichf] == 0 } {
-      set libmpichf $env(MPICH_DIR)/lib/libfmpich.so
-      if { [file exists $libmpichf] == 0 } {
-        puts stderr "Module failed, libfmpich.so not found!"
-        exit [1]
-      }
-    }
-
-    setenv WRAPRUN_PRELOAD $libmpichf:$PREFIX/lib/libsplit.so
+    setenv WRAPRUN_PRELOAD $PREFIX/lib/libsplit.so
 
   MODULEFILE
 end